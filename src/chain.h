@@ -432,17 +432,59 @@ public:
     const CBlockIndex* GetAncestor(int height) const;
 };
 
+/**
+ * Serializes an Equihash solution, or reads past it without allocating it
+ * when the caller will fetch the solution lazily.
+ */
+class CSolutionField
+{
+private:
+    std::vector<unsigned char>& solution;
+    const bool fSkip;
+
+public:
+    CSolutionField(std::vector<unsigned char>& solutionIn, bool fSkipIn) : solution(solutionIn), fSkip(fSkipIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << solution;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        if (fSkip) {
+            s.ignore(ReadCompactSize(s));
+        } else {
+            s >> solution;
+        }
+    }
+};
+
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex
 {
+private:
+    //! (memory only) Whether deserialization keeps the Equihash solution.
+    bool fReadSolution;
+
 public:
     uint256 hashPrev;
 
-    CDiskBlockIndex() : CBlockIndex() {
+    CDiskBlockIndex() : CBlockIndex(), fReadSolution(true) {
+        hashPrev = uint256();
+    }
+
+    /**
+     * With fReadSolutionIn false the solution is skipped on read, so neither
+     * GetBlockHeader nor GetBlockHash can be used on the result.
+     */
+    explicit CDiskBlockIndex(bool fReadSolutionIn) : CBlockIndex(), fReadSolution(fReadSolutionIn) {
         hashPrev = uint256();
     }
 
-    explicit CDiskBlockIndex(const CBlockIndex* pindex, std::function<std::vector<unsigned char>()> getSolution) : CBlockIndex(*pindex) {
+    explicit CDiskBlockIndex(const CBlockIndex* pindex, std::function<std::vector<unsigned char>()> getSolution) : CBlockIndex(*pindex), fReadSolution(true) {
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
         if (!HasSolution()) {
             nSolution = getSolution();
@@ -488,7 +530,7 @@ public:
         READWRITE(nTime);
         READWRITE(nBits);
         READWRITE(nNonce);
-        READWRITE(nSolution);
+        READWRITEMANY(CSolutionField(nSolution, !fReadSolution));
 
         // Only read/write nTransparentValue if the client version used to create
         // this index was storing them.
@@ -114,7 +114,17 @@ bool CCoinsViewBacked::GetStats(CCoinsStats &stats) const { return base->GetStat
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0) { }
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), hasModifier(false),
+    cacheResource(new CCoinsCacheResource()),
+    cacheCoins(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheSproutAnchors(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheSaplingAnchors(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheSaplingFrontierAnchors(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheSproutNullifiers(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheSaplingNullifiers(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheZkOutputProofHash(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cacheZkSpendProofHash(0, CCoinsKeyHasher(), std::equal_to<uint256>(), cacheResource.get()),
+    cachedCoinsUsage(0) { }
 
 CCoinsViewCache::~CCoinsViewCache()
 {
@@ -122,7 +132,8 @@ CCoinsViewCache::~CCoinsViewCache()
 }
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) +
+    return memusage::DynamicUsage(*cacheResource) +
+           memusage::DynamicUsage(cacheCoins) +
            memusage::DynamicUsage(cacheSproutAnchors) +
            memusage::DynamicUsage(cacheSaplingAnchors) +
            memusage::DynamicUsage(cacheSaplingFrontierAnchors) +
@@ -147,7 +158,7 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
     }
-    cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
+    cachedCoinsUsage += ret->second.DynamicMemoryUsage();
     return ret;
 }
 
@@ -517,7 +528,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
         }
     } else {
-        cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
+        cachedCoinUsage = ret.first->second.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
@@ -686,7 +697,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     assert(it->second.flags & CCoinsCacheEntry::FRESH);
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
-                    cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage += entry.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
                 }
             } else {
@@ -694,13 +705,23 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins,
                     // The grandparent does not have an entry, and the child is
                     // modified and being pruned. This means we can just delete
                     // it from the parent.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
+                    if (!(itUs->second.flags & CCoinsCacheEntry::FRESH)) {
+                        // Carry the changed outputs up. A child entry that is
+                        // fresh replaced a pruned one of ours entirely.
+                        if (it->second.flags & CCoinsCacheEntry::FRESH) {
+                            for (uint32_t n = 0; n < it->second.coins.vout.size(); n++)
+                                itUs->second.MarkChanged(n);
+                        }
+                        for (uint32_t n : it->second.changed)
+                            itUs->second.MarkChanged(n);
+                    }
                     itUs->second.coins.swap(it->second.coins);
-                    cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage += itUs->second.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
@@ -736,10 +757,33 @@ bool CCoinsViewCache::Flush() {
     cacheSaplingNullifiers.clear();
     cacheZkOutputProofHash.clear();
     cacheZkSpendProofHash.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+template<typename Map>
+static void ReallocateMap(Map &map, CCoinsCacheResource *resource)
+{
+    // Swapping also swaps the allocators, the old (empty) map goes away with
+    // the temporary while its pool is still alive.
+    Map(0, map.hash_function(), map.key_eq(), resource).swap(map);
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    std::unique_ptr<CCoinsCacheResource> resource(new CCoinsCacheResource());
+    ReallocateMap(cacheCoins, resource.get());
+    ReallocateMap(cacheSproutAnchors, resource.get());
+    ReallocateMap(cacheSaplingAnchors, resource.get());
+    ReallocateMap(cacheSaplingFrontierAnchors, resource.get());
+    ReallocateMap(cacheSproutNullifiers, resource.get());
+    ReallocateMap(cacheSaplingNullifiers, resource.get());
+    ReallocateMap(cacheZkOutputProofHash, resource.get());
+    ReallocateMap(cacheZkSpendProofHash, resource.get());
+    cacheResource.swap(resource);
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -868,11 +912,6 @@ bool CCoinsViewCache::HaveJoinSplitRequirements(const CTransaction& tx, int maxP
         intermediates.insert(std::make_pair(tree.root(), tree));
     }
 
-    auto now = GetTimeMicros();
-
-    //Create a Vector of futures to be collected later
-    std::vector<std::future<bool>> vFutures;
-
     //Setup spend batches
     std::vector<const SpendDescription*> vSpend;
 
@@ -882,31 +921,11 @@ bool CCoinsViewCache::HaveJoinSplitRequirements(const CTransaction& tx, int maxP
         vSpend.emplace_back(&(tx.vShieldedSpend[i]));
     }
 
-    //Push batches of spends to async threads
-    if (!vSpend.empty()) {
-        vFutures.emplace_back(std::async(std::launch::async, HaveJoinSplitRequirementsWorkerNullifier, this, vSpend, 1));
-        vFutures.emplace_back(std::async(std::launch::async, HaveJoinSplitRequirementsWorkerAnchor, this, vSpend, 2));
-    }
-
-
-    //Wait for all threads to complete
-    for (auto &future : vFutures) {
-        future.wait();
-    }
-
-    //Collect the async results
-    bool ret = true;
-    for (auto &future : vFutures) {
-        if (!future.get()) {
-            ret = false;
-        }
-    }
-
-    //cleanup
-    vFutures.resize(0);
-    vSpend.resize(0);
-
-    return ret;
+    // These lookups fill the maps of this cache and its base caches. The maps
+    // of a cache share one PoolResource, which is not thread safe, so the
+    // lookups run one after another on this thread.
+    return HaveJoinSplitRequirementsWorkerNullifier(this, vSpend, 1) &&
+           HaveJoinSplitRequirementsWorkerAnchor(this, vSpend, 2);
 }
 
 static bool HaveJoinSplitRequirementsWorkerDuplicateSpendProofs(const CCoinsViewCache *coinCache,const std::vector<const SpendDescription*> vSpend, int threadNum)
@@ -937,13 +956,6 @@ static bool HaveJoinSplitRequirementsWorkerDuplicateOutputProofs(const CCoinsVie
 
 bool CCoinsViewCache::HaveJoinSplitRequirementsDuplicateProofs(const CTransaction& tx, int maxProcessingThreads) const
 {
-    auto now = GetTimeMicros();
-
-    now = GetTimeMicros();
-
-    //Create a Vector of futures to be collected later
-    std::vector<std::future<bool>> vFutures;
-
     //Setup spend & output batches
     std::vector<const SpendDescription*> vSpend;
     std::vector<const OutputDescription*> vOutput;
@@ -960,38 +972,15 @@ bool CCoinsViewCache::HaveJoinSplitRequirementsDuplicateProofs(const CTransactio
         vOutput.emplace_back(&(tx.vShieldedOutput[i]));
     }
 
-    //Push batches of spends to async threads
-    if (!vSpend.empty()) {
-        //Perform SpendDescription validations
-        vFutures.emplace_back(std::async(std::launch::async, HaveJoinSplitRequirementsWorkerDuplicateSpendProofs, this, vSpend, 1));
-    }
-
-
-    //Push batches of output to async threads
-    if (!vOutput.empty()) {
-        //Perform SpendDescription validations
-        vFutures.emplace_back(std::async(std::launch::async, HaveJoinSplitRequirementsWorkerDuplicateOutputProofs, this, vOutput, 2));
-    }
-
-    //Wait for all threads to complete
-    for (auto &future : vFutures) {
-        future.wait();
-    }
-
-    //Collect the async results
+    // Serial for the same reason as in HaveJoinSplitRequirements, both
+    // lookups insert into the proof hash maps and share the cache's pool.
     bool ret = true;
-    for (auto &future : vFutures) {
-        if (!future.get()) {
-            ret = false;
-        }
-    }
-
-    //cleanup
-    vFutures.resize(0);
-    vSpend.resize(0);
+    if (!vSpend.empty() && !HaveJoinSplitRequirementsWorkerDuplicateSpendProofs(this, vSpend, 1))
+        ret = false;
+    if (!vOutput.empty() && !HaveJoinSplitRequirementsWorkerDuplicateOutputProofs(this, vOutput, 2))
+        ret = false;
 
     return ret;
-
 }
 
 bool CCoinsViewCache::HaveInputs(const CTransaction& tx) const
@@ -1041,6 +1030,15 @@ double CCoinsViewCache::GetPriority(const CTransaction &tx, int nHeight) const
 CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage) {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    const CCoins& coins = it->second.coins;
+    fCoinBaseBefore = coins.fCoinBase;
+    nHeightBefore = coins.nHeight;
+    nVersionBefore = coins.nVersion;
+    if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+        vAvailableBefore.resize(coins.vout.size());
+        for (unsigned int i = 0; i < coins.vout.size(); i++)
+            vAvailableBefore[i] = !coins.vout[i].IsNull();
+    }
 }
 
 CCoinsModifier::~CCoinsModifier()
@@ -1048,11 +1046,20 @@ CCoinsModifier::~CCoinsModifier()
     assert(cache.hasModifier);
     cache.hasModifier = false;
     it->second.coins.Cleanup();
+    if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+        const CCoins& coins = it->second.coins;
+        bool fReplaced = coins.fCoinBase != fCoinBaseBefore || coins.nHeight != nHeightBefore || coins.nVersion != nVersionBefore;
+        for (unsigned int i = 0; i < std::max(vAvailableBefore.size(), coins.vout.size()); i++) {
+            bool fAvailableBefore = i < vAvailableBefore.size() && vAvailableBefore[i];
+            if (fReplaced || fAvailableBefore != coins.IsAvailable(i))
+                it->second.MarkChanged(i);
+        }
+    }
     cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
     } else {
         // If the coin still exists after the modification, add the new usage
-        cache.cachedCoinsUsage += it->second.coins.DynamicMemoryUsage();
+        cache.cachedCoinsUsage += it->second.DynamicMemoryUsage();
     }
 }
@@ -30,9 +30,12 @@
 #include "uint256.h"
 #include "base58.h"
 #include "pubkey.h"
+#include "support/allocators/pool.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <stdint.h>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
@@ -295,6 +298,7 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    std::vector<uint32_t> changed; // Sorted indexes of the outputs that may differ from the parent view (not kept for FRESH entries).
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -302,6 +306,17 @@ struct CCoinsCacheEntry
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
+
+    //! Counted in cachedCoinsUsage, the changed list grows with the outputs spent
+    size_t DynamicMemoryUsage() const {
+        return coins.DynamicMemoryUsage() + memusage::DynamicUsage(changed);
+    }
+
+    void MarkChanged(uint32_t n) {
+        std::vector<uint32_t>::iterator it = std::lower_bound(changed.begin(), changed.end(), n);
+        if (it == changed.end() || *it != n)
+            changed.insert(it, n);
+    }
 };
 
 struct CAnchorsSproutCacheEntry
@@ -380,12 +395,29 @@ enum ProofType
     SPEND,
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
-typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, CCoinsKeyHasher> CAnchorsSproutMap;
-typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, CCoinsKeyHasher> CAnchorsSaplingMap;
-typedef boost::unordered_map<uint256, CAnchorsSaplingFrontierCacheEntry, CCoinsKeyHasher> CAnchorsSaplingFrontierMap;
-typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher> CNullifiersMap;
-typedef boost::unordered_map<uint256, CProofHashCacheEntry, CCoinsKeyHasher> CProofHashMap;
+/**
+ * The maps of a CCoinsViewCache take their nodes from one pool owned by the
+ * cache. The blocks of the pool fit the largest node of these maps; boost
+ * adds a pointer or two per node.
+ */
+static constexpr size_t COINS_CACHE_POOL_BLOCK_SIZE = std::max({
+    sizeof(std::pair<const uint256, CCoinsCacheEntry>),
+    sizeof(std::pair<const uint256, CAnchorsSproutCacheEntry>),
+    sizeof(std::pair<const uint256, CAnchorsSaplingCacheEntry>),
+    sizeof(std::pair<const uint256, CAnchorsSaplingFrontierCacheEntry>),
+    sizeof(std::pair<const uint256, CNullifiersCacheEntry>),
+    sizeof(std::pair<const uint256, CProofHashCacheEntry>)}) + 4 * sizeof(void*);
+
+template<typename Entry>
+using CCoinsCacheAllocator = PoolAllocator<std::pair<const uint256, Entry>, COINS_CACHE_POOL_BLOCK_SIZE, alignof(void*)>;
+typedef CCoinsCacheAllocator<CCoinsCacheEntry>::ResourceType CCoinsCacheResource;
+
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CCoinsCacheEntry> > CCoinsMap;
+typedef boost::unordered_map<uint256, CAnchorsSproutCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CAnchorsSproutCacheEntry> > CAnchorsSproutMap;
+typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CAnchorsSaplingCacheEntry> > CAnchorsSaplingMap;
+typedef boost::unordered_map<uint256, CAnchorsSaplingFrontierCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CAnchorsSaplingFrontierCacheEntry> > CAnchorsSaplingFrontierMap;
+typedef boost::unordered_map<uint256, CNullifiersCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CNullifiersCacheEntry> > CNullifiersMap;
+typedef boost::unordered_map<uint256, CProofHashCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsCacheAllocator<CProofHashCacheEntry> > CProofHashMap;
 
 struct CCoinsStats
 {
@@ -503,6 +535,11 @@ private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
     size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    // State of a non-FRESH entry before modification, to find the outputs that changed
+    std::vector<bool> vAvailableBefore;
+    bool fCoinBaseBefore;
+    int nHeightBefore;
+    int nVersionBefore;
     CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
@@ -529,6 +566,13 @@ protected:
     /* Whether this cache has an active modifier. */
     bool hasModifier;
 
+    /**
+     * Pool for the nodes of the maps below. Declared before them, so that it
+     * outlives them. Not thread safe: even lookups insert into these maps, so
+     * a cache must not be used from several threads at once.
+     */
+    std::unique_ptr<CCoinsCacheResource> cacheResource;
+
     /**
      * Make mutable so that we can "fill the cache" even from Get-methods
      * declared as "const".
@@ -661,6 +705,9 @@ private:
     CCoinsMap::iterator FetchCoins(const uint256 &txid);
     CCoinsMap::const_iterator FetchCoins(const uint256 &txid) const;
 
+    //! Replace the (empty) maps and their pool, returning the pool's memory to the heap
+    void ReallocateCache();
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -116,8 +116,15 @@ typedef void* sockopt_arg_type;
 typedef char* sockopt_arg_type;
 #endif
 
+// Linux waits on sockets with poll() and epoll, neither of which limits
+// descriptors to FD_SETSIZE like select() does.
+#if defined(__linux__)
+#define USE_POLL
+#define USE_EPOLL
+#endif
+
 bool static inline IsSelectableSocket(const SOCKET& s) {
-#ifdef WIN32
+#if defined(USE_POLL) || defined(WIN32)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -2,10 +2,12 @@
 #include "crypto/common.h"
 #include "key.h"
 #include "pubkey.h"
+#include "script/sigcache.h"
 #include "zcash/JoinSplit.hpp"
 #include "util.h"
 
 #include "librustzcash.h"
+#include <rust/bridge.h>
 
 struct ECCryptoClosure
 {
@@ -37,6 +39,10 @@ int main(int argc, char **argv) {
         true
     );
 
+    // Script checks and the Sapling batch validator require their caches to exist
+    InitSignatureCache();
+    bundlecache::init(1 << 20);
+
   testing::InitGoogleMock(&argc, argv);
 
   auto ret = RUN_ALL_TESTS();
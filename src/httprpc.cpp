@@ -26,6 +26,8 @@
 #include "util/strencodings.h"
 #include "ui_interface.h"
 
+#include <set>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 
 // WWW-Authenticate to present with 401 Unauthorized response
@@ -102,6 +104,17 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+/** Methods whose results are sent with chunked transfer encoding, see HTTPRequest::StartChunkedReply */
+static const std::set<std::string> setStreamedRPCMethods = {
+    "getalldata",
+    "getblock",
+    "getrawmempool",
+    "zs_listreceivedbyaddress",
+    "zs_listsentbyaddress",
+    "zs_listspentbyaddress",
+    "zs_listtransactions",
+};
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -153,6 +166,25 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
+            // Stream replies that can run to gigabytes rather than writing them out in one string
+            if (setStreamedRPCMethods.count(jreq.strMethod)) {
+                req->WriteHeader("Content-Type", "application/json");
+                req->StartChunkedReply(HTTP_OK);
+                // Once the reply has started an error reply can no longer be sent,
+                // end the reply instead, the client is left with a truncated body.
+                bool fStreamed = true;
+                try {
+                    JSONRPCReplyChunked(result, NullUniValue, jreq.id, [req](const std::string& strChunk) {
+                        req->WriteReplyChunk(strChunk);
+                    });
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: streaming the reply to %s failed: %s\n", __func__, jreq.strMethod, e.what());
+                    fStreamed = false;
+                }
+                req->EndChunkedReply();
+                return fStreamed;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -558,7 +558,8 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunkedReply(false)
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -566,7 +567,10 @@ HTTPRequest::~HTTPRequest()
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (chunkedReply)
+            EndChunkedReply();
+        else
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -614,9 +618,25 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  * Replies must be sent in the main loop in the main http thread,
  * this cannot be done from worker threads.
  */
+/** Re-enable reading from the socket once a reply is complete. This is the
+ * second part of the libevent workaround in http_request_cb.
+ */
+static void http_reenable_read(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !chunkedReply && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -624,19 +644,149 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, (const char*)NULL, (struct evbuffer *)NULL);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+        http_reenable_read(req_copy);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+/** Bytes of a chunked reply that may wait for the client before WriteReplyChunk blocks */
+static const size_t MAX_CHUNKED_REPLY_BUFFER = 1024 * 1024;
+
+/** State shared by the worker writing a chunked reply and the main http
+ * thread sending it. The worker waits on cond while too much of the reply is
+ * queued, the main thread wakes it as the connection's output buffer drains
+ * or when the client goes away.
+ */
+struct HTTPChunkedReplyState
+{
+    boost::mutex cs;
+    boost::condition_variable cond;
+    size_t nQueued;   //!< Handed to the main thread, not yet in the output buffer
+    size_t nBuffered; //!< In the connection's output buffer
+    bool fClosed;     //!< The client disconnected, the rest of the reply is dropped
+
+    // Only used on the main http thread
+    struct evhttp_request* req;
+    struct evbuffer_cb_entry* outputCb;
+
+    HTTPChunkedReplyState(struct evhttp_request* reqIn) :
+        nQueued(0), nBuffered(0), fClosed(false), req(reqIn), outputCb(NULL) {}
+
+    bool IsFull() const { return nQueued + nBuffered >= MAX_CHUNKED_REPLY_BUFFER; }
+};
+
+static struct evbuffer* http_output_buffer(struct evhttp_request* req)
+{
+    evhttp_connection* conn = evhttp_request_get_connection(req);
+    if (!conn)
+        return NULL;
+    bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+    return bev ? bufferevent_get_output(bev) : NULL;
+}
+
+/** Output buffer callback, wakes the worker once the client has read enough */
+static void http_chunked_output_cb(struct evbuffer* buffer, const struct evbuffer_cb_info*, void* arg)
+{
+    HTTPChunkedReplyState* state = static_cast<HTTPChunkedReplyState*>(arg);
+    boost::lock_guard<boost::mutex> lock(state->cs);
+    state->nBuffered = evbuffer_get_length(buffer);
+    if (!state->IsFull())
+        state->cond.notify_all();
+}
+
+/** Connection close callback. libevent detaches the request from the closing
+ * connection and keeps it until evhttp_send_reply_end, which frees it.
+ */
+static void http_chunked_close_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkedReplyState* state = static_cast<HTTPChunkedReplyState*>(arg);
+    state->outputCb = NULL; // freed with the connection's buffer
+    boost::lock_guard<boost::mutex> lock(state->cs);
+    state->fClosed = true;
+    state->cond.notify_all();
+}
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !chunkedReply && req);
+    // Events triggered from here run on the main http thread in the order
+    // they were triggered, so the chunks follow the reply start.
+    chunkState = std::make_shared<HTTPChunkedReplyState>(req);
+    auto state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [state, nStatus]{
+        evhttp_connection* conn = evhttp_request_get_connection(state->req);
+        if (!conn) {
+            // The client is already gone
+            boost::lock_guard<boost::mutex> lock(state->cs);
+            state->fClosed = true;
+            state->cond.notify_all();
+            return;
+        }
+        evhttp_send_reply_start(state->req, nStatus, (const char*)NULL);
+        evhttp_connection_set_closecb(conn, http_chunked_close_cb, state.get());
+        struct evbuffer* output = http_output_buffer(state->req);
+        if (output)
+            state->outputCb = evbuffer_add_cb(output, http_chunked_output_cb, state.get());
+    });
+    ev->trigger(0);
+    chunkedReply = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && chunkedReply && req);
+    if (strChunk.empty())
+        return; // an empty chunk would end the body
+    {
+        boost::unique_lock<boost::mutex> lock(chunkState->cs);
+        while (!chunkState->fClosed && chunkState->IsFull())
+            chunkState->cond.wait(lock);
+        if (chunkState->fClosed)
+            return;
+        chunkState->nQueued += strChunk.size();
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [state, evb]{
+        size_t nSize = evbuffer_get_length(evb);
+        // Checked per chunk, the client can disconnect between events
+        if (evhttp_request_get_connection(state->req))
+            evhttp_send_reply_chunk(state->req, evb);
+        evbuffer_free(evb);
+        struct evbuffer* output = http_output_buffer(state->req);
+        boost::lock_guard<boost::mutex> lock(state->cs);
+        state->nQueued -= nSize;
+        state->nBuffered = output ? evbuffer_get_length(output) : 0;
+        if (!state->IsFull())
+            state->cond.notify_all();
+    });
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && chunkedReply && req);
+    auto state = chunkState;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [state]{
+        evhttp_connection* conn = evhttp_request_get_connection(state->req);
+        if (conn) {
+            // Unhook before ending, the connection may close with the reply
+            evhttp_connection_set_closecb(conn, NULL, NULL);
+            struct evbuffer* output = http_output_buffer(state->req);
+            if (output && state->outputCb)
+                evbuffer_remove_cb_entry(output, state->outputCb);
+            state->outputCb = NULL;
+            http_reenable_read(state->req);
         }
+        // Frees the request right away if the client is gone, do not touch it after this
+        evhttp_send_reply_end(state->req);
     });
     ev->trigger(0);
+    chunkState.reset();
     replySent = true;
     req = 0; // transferred back to main thread
 }
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <memory>
 #include <string>
 #include <stdint.h>
 #ifdef _WIN32
@@ -22,6 +23,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPChunkedReplyState;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -59,10 +61,13 @@ class HTTPRequest
 {
 private:
     struct evhttp_request* req;
+    /** Shared with the main http thread while a chunked reply is sent */
+    std::shared_ptr<HTTPChunkedReplyState> chunkState;
 
     // For test access
 protected:
     bool replySent;
+    bool chunkedReply;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -118,6 +123,28 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply sent with chunked transfer encoding, so the body can be
+     * handed to the client as it is produced instead of as one string.
+     * Follow with any number of WriteReplyChunk calls and one EndChunkedReply.
+     *
+     * @note Use instead of WriteReply, write headers before calling this.
+     */
+    virtual void StartChunkedReply(int nStatus);
+
+    /**
+     * Queue the next piece of a chunked reply body. Blocks while the client
+     * has a full buffer of earlier pieces left to read. Once the client has
+     * disconnected the pieces are dropped.
+     */
+    virtual void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply. Like WriteReply, this gives the request back to
+     * the main thread, do not call any other HTTPRequest methods afterwards.
+     */
+    virtual void EndChunkedReply();
 };
 
 /** Event handler closure.
@@ -26,6 +26,7 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockencodings.h"
 #include "importcoin.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -41,6 +42,7 @@
 #include "netmessagemaker.h"
 #include "pow.h"
 #include "script/interpreter.h"
+#include "threadpool.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -62,10 +64,12 @@
 #include "komodo_interest.h"
 #include "rpc/net.h"
 #include "cc/CCinclude.h"
+#include "util/mappedfile.h"
 
 #include <cstring>
 #include <algorithm>
 #include <atomic>
+#include <list>
 #include <sstream>
 #include <map>
 #include <unordered_map>
@@ -275,6 +279,7 @@ namespace {
         int64_t nTime;  //! Time of "getdata" request in microseconds.
         bool fValidatedHeaders;  //! Whether this block has validated headers at the time of request.
         int64_t nTimeDisconnect; //! The timeout for this block request (for disconnecting a slow peer)
+        std::shared_ptr<PartiallyDownloadedBlock> partialBlock;  //! Set while the block is rebuilt from a "cmpctblock".
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -284,6 +289,9 @@ namespace {
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0;
 
+    /** Peers we asked to announce blocks with "cmpctblock", oldest first. Protected by cs_main. */
+    std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
     /** Dirty block index entries. */
     set<CBlockIndex*> setDirtyBlockIndex;
 
@@ -415,6 +423,7 @@ namespace {
         mapBlocksInFlight.erase(entry.hash);
         EraseOrphansFor(nodeid);
         nPreferredDownload -= state->fPreferredDownload;
+        lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
         mapNodeState.erase(nodeid);
     }
@@ -449,7 +458,8 @@ namespace {
     }
 
     // Requires cs_main.
-    void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex *pindex = NULL) {
+    // Returns the queue entry, so a compact block can attach its partial block.
+    list<QueuedBlock>::iterator MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex *pindex = NULL) {
         CNodeState *state = State(nodeid);
         assert(state != NULL);
 
@@ -457,12 +467,51 @@ namespace {
         MarkBlockAsReceived(hash);
 
         int64_t nNow = GetTimeMicros();
-        QueuedBlock newentry = {hash, pindex, nNow, pindex != NULL, GetBlockTimeout(nNow, nQueuedValidatedHeaders, consensusParams)};
+        QueuedBlock newentry = {hash, pindex, nNow, pindex != NULL, GetBlockTimeout(nNow, nQueuedValidatedHeaders, consensusParams), nullptr};
         nQueuedValidatedHeaders += newentry.fValidatedHeaders;
         list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
         state->nBlocksInFlight++;
         state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
         mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
+        return it;
+    }
+
+    /** Whether our tip is recent enough to fetch announced blocks directly instead of through the download window. */
+    bool CanDirectFetch(const Consensus::Params& consensusParams)
+    {
+        return chainActive.Tip()->GetBlockTime() > GetTime() - consensusParams.nPowTargetSpacing * 20;
+    }
+
+    /**
+     * Ask the peer that just gave us a new tip to announce its next blocks
+     * with "cmpctblock", saving the inv/getdata round trip. Only the last
+     * MAX_CMPCTBLOCK_HB_PEERS such peers are kept in this mode.
+     * Requires cs_main.
+     */
+    void MaybeSetPeerAsAnnouncingHeaderAndIDs(CNode* pfrom)
+    {
+        if (!pfrom->fSupportsCompactBlocks)
+            return;
+        for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+            if (*it == pfrom->GetId()) {
+                lNodesAnnouncingHeaderAndIDs.erase(it);
+                lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+                return;
+            }
+        }
+        if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_HB_PEERS) {
+            NodeId nodeidOldest = lNodesAnnouncingHeaderAndIDs.front();
+            lNodesAnnouncingHeaderAndIDs.pop_front();
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodes) {
+                if (pnode->GetId() == nodeidOldest) {
+                    pnode->PushMessage(NetMsgType::SENDCMPCT, false, CMPCTBLOCKS_VERSION);
+                    break;
+                }
+            }
+        }
+        pfrom->PushMessage(NetMsgType::SENDCMPCT, true, CMPCTBLOCKS_VERSION);
+        lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
     }
 
     /** Check whether the last unknown block a peer advertized is not yet known. */
@@ -624,6 +673,7 @@ void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
+    nodeSignals.ProcessGetData.connect(&ProcessGetData);
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
@@ -633,6 +683,7 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.disconnect(&GetHeight);
     nodeSignals.ProcessMessages.disconnect(&ProcessMessages);
+    nodeSignals.ProcessGetData.disconnect(&ProcessGetData);
     nodeSignals.SendMessages.disconnect(&SendMessages);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
@@ -1454,6 +1505,44 @@ CheckTransationResults ContextualCheckTransactionSaplingOutputWorker(
 
 }
 
+/**
+ * Convert a transaction to its Rust representation and return the Sapling bundle,
+ * which is the form the Rust batch validator consumes.
+ */
+static SaplingBundle GetRustSaplingBundle(const CTransaction& tx)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tx;
+    CRustTransaction rTx;
+    ss >> rTx;
+    return rTx.GetSaplingBundle();
+}
+
+bool ContextualCheckTransactionSaplingBatch(
+    const std::vector<const CTransaction*> vtx,
+    const std::vector<uint256> vTxSig,
+    const bool cacheStore) {
+
+    //When storing, bundles that pass are recorded in the bundle validity cache (mempool acceptance).
+    //When not storing, bundles found in the cache are skipped and evicted (block connection).
+    auto batch = sapling::init_batch_validator(cacheStore);
+
+    try {
+        for (int i = 0; i < vtx.size(); i++) {
+            //Queue the spend proofs, spend auth sigs, output proofs and binding sig of this bundle
+            if (!GetRustSaplingBundle(*vtx[i]).QueueAuthValidation(*batch, vTxSig[i])) {
+                return false;
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrint("bench", "%s: unable to queue sapling bundle: %s\n", __func__, e.what());
+        return false;
+    }
+
+    //Single multiscalar multiplication over every queued proof and signature
+    return batch->validate();
+}
+
 /**
  * Check a transaction contextually against a set of consensus rules valid at a given block height.
  *
@@ -1462,47 +1551,30 @@ CheckTransationResults ContextualCheckTransactionSaplingOutputWorker(
  * 2. ProcessNewBlock calls AcceptBlock, which calls CheckBlock (which calls CheckTransaction)
  *    and ContextualCheckBlock (which calls this function).
  * 3. The isInitBlockDownload argument is only to assist with testing.
+ * 4. Sapling proofs and signatures of all transactions are batch validated together; the
+ *    per description workers only run if the batch fails, to identify the invalid transaction.
+ * 5. cacheSaplingBundles records the bundles that pass in the bundle validity cache, so the
+ *    proofs are not verified again when the transaction is later seen in a block.
  */
 bool ContextualCheckTransactionMultithreaded(int32_t slowflag, const std::vector<const CTransaction*> vptx, CBlockIndex * const previndex,
         CValidationState &state,
         const int nHeight,
         const int dosLevel,
-        bool (*isInitBlockDownload)(),int32_t validateprices) {
-
-      //Create a Vector of futures to be collected later
-      std::vector<std::future<CheckTransationResults>> vFutures;
+        bool (*isInitBlockDownload)(),int32_t validateprices,
+        bool cacheSaplingBundles) {
 
       bool isInitialBlockDownload = isInitBlockDownload();
 
-      //Setup tx batches
-      std::vector<const CTransaction*> vtx;
-      std::vector<std::vector<const CTransaction*>> vvtx;
-      std::vector<uint256> vTxSig;
-      std::vector<std::vector<uint256>> vvTxSig;
+      //Setup block wide sapling batch
+      std::vector<const CTransaction*> vSaplingTx;
+      std::vector<uint256> vSaplingTxSig;
 
-      //Setup spend batches
+      //Setup spend and output lists for the individual checks
       std::vector<const SpendDescription*> vSpend;
-      std::vector<std::vector<const SpendDescription*>> vvSpend;
       std::vector<uint256> vSpendSig;
-      std::vector<std::vector<uint256>> vvSpendSig;
-
-      //Setup output batches
       std::vector<const OutputDescription*> vOutput;
-      std::vector<std::vector<const OutputDescription*>> vvOutput;
-
-      //Create Thread Vectors
-      for (int i = 0; i < maxProcessingThreads; i++) {
-          vvtx.emplace_back(vtx);
-          vvTxSig.emplace_back(vTxSig);
-          vvSpend.emplace_back(vSpend);
-          vvSpendSig.emplace_back(vSpendSig);
-          vvOutput.emplace_back(vOutput);
-      }
 
-      //Check coinbase transaction and push all transactions to thread batch vectors
-      int t = 0;
-      int s = 0;
-      int o = 0;
+      //Check coinbase transaction and collect all sapling transactions
       for (uint32_t i = 0; i < vptx.size(); i++) {
           const CTransaction* tx = vptx[i];
 
@@ -1550,79 +1622,74 @@ bool ContextualCheckTransactionMultithreaded(int32_t slowflag, const std::vector
           if (!fCheckpointsEnabled || nHeight >= Checkpoints::GetTotalBlocksEstimate(Params().Checkpoints())) {
               //Verify Sapling
               if (!tx->vShieldedSpend.empty() || !tx->vShieldedOutput.empty()) {
-                  //Push tx to thread vector
-                  vvtx[t].emplace_back(tx);
-                  vvTxSig[t].emplace_back(dataToBeSigned);
-                  //Increment thread vector
-                  t++;
-                  //reset if tread vector is greater qty of threads being used
-                  if (t >= vvtx.size()) {
-                      t = 0;
-                  }
+                  //Push tx to the block wide batch
+                  vSaplingTx.emplace_back(tx);
+                  vSaplingTxSig.emplace_back(dataToBeSigned);
 
-                  //Add this transaction sapling spend to spend thread batches
-                  for (int j = 0; j < tx->vShieldedSpend.size(); j++) {
-                      //Push spend to thread vector
-                      vvSpend[s].emplace_back(&(tx->vShieldedSpend[j]));
-                      vvSpendSig[s].emplace_back(dataToBeSigned);
-                      //Increment thread vector
-                      s++;
-                      //reset if tread vector is greater qty of threads being used
-                      if (s >= vvSpend.size()) {
-                          s = 0;
-                      }
+                  for (const SpendDescription &spend : tx->vShieldedSpend) {
+                      vSpend.emplace_back(&spend);
+                      vSpendSig.emplace_back(dataToBeSigned);
                   }
 
-                  //Add this transaction sapling outputs to output thread batches
-                  for (int j = 0; j < tx->vShieldedOutput.size(); j++) {
-                      //Push output to thread vector
-                      vvOutput[o].emplace_back(&(tx->vShieldedOutput[j]));
-                      //Increment thread vector
-                      o++;
-                      //reset if tread vector is greater qty of threads being used
-                      if (o >= vvOutput.size()) {
-                          o = 0;
-                      }
+                  for (const OutputDescription &output : tx->vShieldedOutput) {
+                      vOutput.emplace_back(&output);
                   }
               }
           }
       }
 
-      //Push batches of txs to async threads
-      for (int i = 0; i < vvtx.size(); i++) {
-          //Perform transaction level checks
-          if (!vvtx[i].empty()) {
-              vFutures.emplace_back(std::async(std::launch::async, ContextualCheckTransactionBindingSigWorker, vvtx[i], vvTxSig[i], i));
-          }
+      //Batch validate all Sapling bundles, nothing more to do if the whole batch is valid
+      if (vSaplingTx.empty() || ContextualCheckTransactionSaplingBatch(vSaplingTx, vSaplingTxSig, cacheSaplingBundles)) {
+          return true;
       }
 
-      //Push batches of spends to async threads
-      for (int i = 0; i < vvSpend.size(); i++) {
-          //Perform SpendDescription validations
-          if (!vvSpend[i].empty()) {
-              vFutures.emplace_back(std::async(std::launch::async, ContextualCheckTransactionSaplingSpendWorker, vvSpend[i], vvSpendSig[i], i + vvtx.size()));
-          }
+      //The batch failed, fall back to the individual checks to find the invalid transaction
+      LogPrint("bench", "%s: sapling batch validation failed at height %d, checking bundles individually\n", __func__, nHeight);
+
+      CThreadPool& pool = GetProcessingThreadPool();
+      size_t nChunks = std::max(pool.Size(), 1);
+
+      //Create a Vector of futures to be collected later
+      std::vector<std::future<CheckTransationResults>> vFutures;
+
+      //Binding signature checks cost grows with the number of descriptions in the transaction
+      std::vector<uint64_t> vTxCost;
+      for (const CTransaction* tx : vSaplingTx) {
+          vTxCost.emplace_back(1 + tx->vShieldedSpend.size() + tx->vShieldedOutput.size());
+      }
+      for (const auto& chunk : PartitionByCost(vTxCost, nChunks)) {
+          vFutures.emplace_back(pool.Submit([&vSaplingTx, &vSaplingTxSig, chunk]() {
+              return ContextualCheckTransactionBindingSigWorker(
+                  std::vector<const CTransaction*>(vSaplingTx.begin() + chunk.first, vSaplingTx.begin() + chunk.second),
+                  std::vector<uint256>(vSaplingTxSig.begin() + chunk.first, vSaplingTxSig.begin() + chunk.second),
+                  chunk.first);
+          }));
       }
 
-      //Push batches of outputs to async threads
-      for (int i = 0; i < vvOutput.size(); i++) {
-          //Perform OutputDescription validations
-          if (!vvOutput[i].empty()) {
-              vFutures.emplace_back(std::async(std::launch::async, ContextualCheckTransactionSaplingOutputWorker, vvOutput[i], i + vvtx.size() + vvSpend.size()));
-          }
+      //Every spend and output proof costs the same, so split them evenly
+      for (const auto& chunk : PartitionEvenly(vSpend.size(), nChunks)) {
+          vFutures.emplace_back(pool.Submit([&vSpend, &vSpendSig, chunk]() {
+              return ContextualCheckTransactionSaplingSpendWorker(
+                  std::vector<const SpendDescription*>(vSpend.begin() + chunk.first, vSpend.begin() + chunk.second),
+                  std::vector<uint256>(vSpendSig.begin() + chunk.first, vSpendSig.begin() + chunk.second),
+                  chunk.first);
+          }));
       }
 
-      //Wait for all threads to complete
-      for (auto &future : vFutures) {
-          future.wait();
+      for (const auto& chunk : PartitionEvenly(vOutput.size(), nChunks)) {
+          vFutures.emplace_back(pool.Submit([&vOutput, chunk]() {
+              return ContextualCheckTransactionSaplingOutputWorker(
+                  std::vector<const OutputDescription*>(vOutput.begin() + chunk.first, vOutput.begin() + chunk.second),
+                  chunk.first);
+          }));
       }
 
       bool checkResults = true;
       CheckTransationResults failedResult;
 
-      //Collect the async results
+      //Wait for all tasks to complete and collect the results
       for (auto &future : vFutures) {
-          auto result = future.get();
+          auto result = pool.Wait(future);
           if (!result.validationPassed) {
               checkResults = false;
               //Return the highest dosLevel error, or first error if there are multiple equal dosLevel errors
@@ -2333,7 +2400,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     // Check transaction contextually against the set of consensus rules which apply in the next block to be mined.
     std::vector<const CTransaction*> vptx;
     vptx.emplace_back(&tx);
-    if (!ContextualCheckTransactionMultithreaded(0, vptx, 0, state, nextBlockHeight, (dosLevel == -1) ? 10 : dosLevel))
+    // Sapling bundles that pass are cached so ConnectBlock can skip their proofs.
+    if (!ContextualCheckTransactionMultithreaded(0, vptx, 0, state, nextBlockHeight, (dosLevel == -1) ? 10 : dosLevel, IsInitialBlockDownload, 1, true))
     {
         return error("AcceptToMemoryPool: ContextualCheckTransaction failed");
     }
@@ -2801,8 +2869,9 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
 {
     memset(&hashBlock,0,sizeof(hashBlock));
 
-    LOCK(cs_main);
-
+    // The mempool and the block tree have locks of their own, cs_main is only
+    // needed to find the block through the coins view. Disk reads run without
+    // it so concurrent RPC calls don't queue behind each other and validation.
     if (mempool.lookup(hash, txOut))
     {
         return true;
@@ -2829,33 +2898,34 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
         }
     }
 
-    CBlockIndex *pindexSlow = nullptr;
     if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
         int nHeight = -1;
+        CDiskBlockPos blockPos;
+        uint256 hashSlow;
         {
+            LOCK(cs_main);
             const CCoins* coins = pcoinsTip->AccessCoins(hash);
-            if (coins != nullptr)
+            if (coins != nullptr && coins->nHeight > 0)
             {
-                nHeight = coins->nHeight;
-                if (nHeight > 0)
+                CBlockIndex *pindexSlow = chainActive[coins->nHeight];
+                if (pindexSlow != nullptr)
                 {
-                    CBlockIndex *pindexSlow = chainActive[nHeight];
-                    if (pindexSlow != nullptr)
-                    {
-                        CBlock block;
-                        if (ReadBlockFromDisk(block, pindexSlow,1))
-                        {
-                            for(const CTransaction &tx : block.vtx)
-                            {
-                                if (tx.GetHash() == hash)
-                                {
-                                    txOut = tx;
-                                    hashBlock = pindexSlow->GetBlockHash();
-                                    return true;
-                                }
-                            }
-                        }
-                    }
+                    nHeight = pindexSlow->nHeight;
+                    blockPos = pindexSlow->GetBlockPos();
+                    hashSlow = pindexSlow->GetBlockHash();
+                }
+            }
+        }
+        CBlock block;
+        if (nHeight > 0 && ReadBlockFromDisk(nHeight, block, blockPos, 1) && block.GetHash() == hashSlow)
+        {
+            for(const CTransaction &tx : block.vtx)
+            {
+                if (tx.GetHash() == hash)
+                {
+                    txOut = tx;
+                    hashBlock = hashSlow;
+                    return true;
                 }
             }
         }
@@ -2890,26 +2960,93 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     return true;
 }
 
+namespace {
+
+/**
+ * Read-only memory maps of the block files that are no longer appended to,
+ * by file number. Blocks in them are deserialized straight from the page
+ * cache, without a file open, seek and read for every block.
+ */
+class CBlockFileMaps
+{
+private:
+    CCriticalSection cs;
+    //! Files that can't be mapped are remembered as null, so they are not retried on every read
+    std::map<int, std::shared_ptr<const CMappedFile>> mapFiles;
+
+public:
+    /** Map of a block file, or null if it is still being written to or can't be mapped */
+    std::shared_ptr<const CMappedFile> Get(int nFile)
+    {
+        {
+            LOCK(cs_LastBlockFile);
+            // The last file still grows and is truncated when it is finished,
+            // only files before it are final.
+            if (nFile >= nLastBlockFile)
+                return nullptr;
+        }
+
+        LOCK(cs);
+        auto it = mapFiles.find(nFile);
+        if (it != mapFiles.end())
+            return it->second;
+        std::shared_ptr<const CMappedFile> file = CMappedFile::Open(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+        mapFiles[nFile] = file;
+        return file;
+    }
+
+    /** Forget a file that is about to be deleted, readers holding it keep a valid map */
+    void Erase(int nFile)
+    {
+        LOCK(cs);
+        mapFiles.erase(nFile);
+    }
+
+    void Clear()
+    {
+        LOCK(cs);
+        mapFiles.clear();
+    }
+};
+
+CBlockFileMaps blockFileMaps;
+
+} // anon namespace
+
 bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bool checkPOW)
 {
     uint8_t pubkey33[33];
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
+    std::shared_ptr<const CMappedFile> mapped = blockFileMaps.Get(pos.nFile);
+    if (mapped && pos.nPos < mapped->size())
     {
-        //fprintf(stderr,"readblockfromdisk err A\n");
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, mapped->data() + pos.nPos, mapped->data() + mapped->size());
+        try {
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
+    else
+    {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+        {
+            //fprintf(stderr,"readblockfromdisk err A\n");
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+        }
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        fprintf(stderr,"readblockfromdisk err B\n");
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            fprintf(stderr,"readblockfromdisk err B\n");
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
     // Check the header
     if ( 0 && checkPOW != 0 )
@@ -2939,6 +3076,132 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW)
     return true;
 }
 
+/** Read the magic and size WriteBlockToDisk put in front of a block, then the block bytes */
+template <typename Stream>
+static bool ReadRawBlock(Stream& s, CDataStream& ssBlock, const CDiskBlockPos& pos)
+{
+    try {
+        CMessageHeader::MessageStartChars blk_start;
+        unsigned int nSize;
+        s >> FLATDATA(blk_start) >> nSize;
+        if (memcmp(blk_start, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return error("%s: block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_PROTOCOL_MESSAGE_LENGTH)
+            return error("%s: block size %u too large at %s", __func__, nSize, pos.ToString());
+
+        ssBlock.clear();
+        ssBlock.resize(nSize);
+        s.read(&ssBlock[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CDataStream& ssBlock, const CDiskBlockPos& pos)
+{
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    CDiskBlockPos hpos(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    std::shared_ptr<const CMappedFile> mapped = blockFileMaps.Get(hpos.nFile);
+    if (mapped && hpos.nPos < mapped->size()) {
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, mapped->data() + hpos.nPos, mapped->data() + mapped->size());
+        return ReadRawBlock(reader, ssBlock, pos);
+    }
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    return ReadRawBlock(filein, ssBlock, pos);
+}
+
+namespace {
+
+/**
+ * Serialized blocks recently sent to peers, evicting the least recently
+ * served one first. Wallets doing their initial sync tend to ask for the
+ * same recent blocks, which are then read from disk only once.
+ */
+class CServedBlockCache
+{
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CDataStream>>> BlockList;
+
+    CCriticalSection cs;
+    size_t nMaxBytes;
+    size_t nBytes = 0;
+    BlockList lBlocks;
+    std::unordered_map<uint256, BlockList::iterator, BlockHasher> mapBlocks;
+
+public:
+    explicit CServedBlockCache(size_t nMaxBytesIn) : nMaxBytes(nMaxBytesIn) {}
+
+    std::shared_ptr<const CDataStream> Get(const uint256& hash)
+    {
+        LOCK(cs);
+        auto it = mapBlocks.find(hash);
+        if (it == mapBlocks.end())
+            return nullptr;
+        lBlocks.splice(lBlocks.begin(), lBlocks, it->second);
+        return it->second->second;
+    }
+
+    void Put(const uint256& hash, const std::shared_ptr<const CDataStream>& ssBlock)
+    {
+        if (ssBlock->size() > nMaxBytes)
+            return;
+
+        LOCK(cs);
+        if (mapBlocks.count(hash))
+            return;
+        lBlocks.emplace_front(hash, ssBlock);
+        mapBlocks[hash] = lBlocks.begin();
+        nBytes += ssBlock->size();
+        while (nBytes > nMaxBytes) {
+            nBytes -= lBlocks.back().second->size();
+            mapBlocks.erase(lBlocks.back().first);
+            lBlocks.pop_back();
+        }
+    }
+};
+
+/**
+ * Get a block in its network serialization, from the served block cache or
+ * read from disk. Only the header is deserialized, to check that this is the
+ * block that was asked for.
+ */
+std::shared_ptr<const CDataStream> GetServedBlock(const uint256& hash, const CDiskBlockPos& pos)
+{
+    static CServedBlockCache cache((size_t)std::max(GetArg("-blockservecache", DEFAULT_BLOCK_SERVE_CACHE), (int64_t)0) << 20);
+
+    std::shared_ptr<const CDataStream> cached = cache.Get(hash);
+    if (cached)
+        return cached;
+
+    std::shared_ptr<CDataStream> ssBlock = std::make_shared<CDataStream>(SER_NETWORK, PROTOCOL_VERSION);
+    if (!ReadRawBlockFromDisk(*ssBlock, pos))
+        return nullptr;
+
+    try {
+        CBlockHeader header;
+        size_t nSize = ssBlock->size();
+        *ssBlock >> header;
+        ssBlock->Rewind(nSize - ssBlock->size());
+        if (header.GetHash() != hash)
+            return nullptr;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: unable to read header of block %s: %s\n", __func__, hash.ToString(), e.what());
+        return nullptr;
+    }
+
+    cache.Put(hash, ssBlock);
+    return ssBlock;
+}
+
+} // anon namespace
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     if (chainName.isKMD()) {
@@ -4436,12 +4699,14 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nCoinCacheUsage;
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
         bool fPeriodicWrite = mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
+        // Many index entries are waiting to be written, and each new one still holds its Equihash solution in memory.
+        bool fIndexLarge = mode != FLUSH_STATE_NONE && setDirtyBlockIndex.size() > DIRTY_BLOCK_INDEX_WRITE_THRESHOLD;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
         bool fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
         // Write blocks and block index to disk.
-        if (fDoFullFlush || fPeriodicWrite) {
+        if (fDoFullFlush || fPeriodicWrite || fIndexLarge) {
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(0))
                 return state.Error("out of disk space");
@@ -4813,6 +5078,82 @@ int32_t komodo_activate_canopy(CBlockIndex *pindex)
     }
     return activation;
 }
+namespace {
+
+/**
+ * Reads the next blocks ActivateBestChainStep is going to connect on the
+ * processing pool, so that reading and deserializing a block overlaps with
+ * connecting the one before it. Only used with cs_main held.
+ */
+class CBlockPrefetcher
+{
+private:
+    //! Blocks read ahead of the one being connected at most
+    static const size_t MAX_PREFETCH = 16;
+
+    struct Prefetch {
+        int nHeight;
+        std::future<std::shared_ptr<CBlock>> result;
+    };
+    std::map<uint256, Prefetch> mapPrefetch;
+
+public:
+    /** Start reading blocks, in the order they will be connected */
+    void Start(const std::vector<CBlockIndex*>& vpindex)
+    {
+        AssertLockHeld(cs_main);
+        CThreadPool& pool = GetProcessingThreadPool();
+        if (pool.Size() == 0)
+            return;
+
+        for (CBlockIndex* pindex : vpindex) {
+            if (mapPrefetch.size() >= MAX_PREFETCH)
+                break;
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || mapPrefetch.count(pindex->GetBlockHash()))
+                continue;
+
+            const uint256 hash = pindex->GetBlockHash();
+            const CDiskBlockPos pos = pindex->GetBlockPos();
+            const int nHeight = pindex->nHeight;
+            Prefetch& prefetch = mapPrefetch[hash];
+            prefetch.nHeight = nHeight;
+            prefetch.result = pool.Submit([hash, pos, nHeight]() {
+                std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(nHeight, *block, pos, 1) || block->GetHash() != hash)
+                    return std::shared_ptr<CBlock>();
+                return block;
+            });
+        }
+    }
+
+    /**
+     * The prefetched block, or null if it was not prefetched or could not be
+     * read. Blocks prefetched at or below its height are on another branch
+     * now and are dropped.
+     */
+    std::shared_ptr<CBlock> Take(const CBlockIndex* pindex)
+    {
+        AssertLockHeld(cs_main);
+        std::shared_ptr<CBlock> block;
+        auto it = mapPrefetch.find(pindex->GetBlockHash());
+        if (it != mapPrefetch.end()) {
+            block = GetProcessingThreadPool().Wait(it->second.result);
+            mapPrefetch.erase(it);
+        }
+        for (it = mapPrefetch.begin(); it != mapPrefetch.end();) {
+            if (it->second.nHeight <= pindex->nHeight)
+                it = mapPrefetch.erase(it);
+            else
+                it++;
+        }
+        return block;
+    }
+};
+
+CBlockPrefetcher blockPrefetcher;
+
+} // anon namespace
+
 static int64_t nTimeReadFromDisk = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
@@ -4833,10 +5174,16 @@ bool ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *pblock)
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
     CBlock block;
+    std::shared_ptr<CBlock> prefetched;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew,1))
-            return AbortNode(state, "Failed to read block");
-        pblock = &block;
+        prefetched = blockPrefetcher.Take(pindexNew);
+        if (prefetched) {
+            pblock = prefetched.get();
+        } else {
+            if (!ReadBlockFromDisk(block, pindexNew,1))
+                return AbortNode(state, "Failed to read block");
+            pblock = &block;
+        }
     }
     KOMODO_CONNECTING = (int32_t)pindexNew->nHeight;
     // Get the current commitment tree
@@ -5127,6 +5474,14 @@ static bool ActivateBestChainStep(bool fSkipdpow, CValidationState &state, CBloc
         }
         nHeight = nTargetHeight;
 
+        // Read the blocks after the first while it is being connected
+        if (vpindexToConnect.size() > 1) {
+            std::vector<CBlockIndex*> vpindexPrefetch(vpindexToConnect.rbegin() + 1, vpindexToConnect.rend());
+            if (pblock != NULL && vpindexPrefetch.back() == pindexMostWork)
+                vpindexPrefetch.pop_back();
+            blockPrefetcher.Start(vpindexPrefetch);
+        }
+
         // Connect new blocks.
         BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect)
         {
@@ -5209,6 +5564,8 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, bool fNotifyUI,
 
         const CBlockIndex *pindexFork;
 
+        // Peers in compact block high bandwidth mode get the block itself right away
+        std::unique_ptr<CBlockHeaderAndShortTxIDs> pcmpctblock;
         bool fInitialDownload;
         {
             LOCK(cs_main);
@@ -5220,6 +5577,11 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, bool fNotifyUI,
             if (pindexMostWork == NULL || pindexMostWork == chainActive.Tip())
                 return true;
 
+            // Connecting the block drops its transactions from the mempool, so the
+            // compact block has to see the pool first to prefill what peers lack
+            if (pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() && !IsInitialBlockDownload())
+                pcmpctblock.reset(new CBlockHeaderAndShortTxIDs(*pblock, &mempool));
+
             if (!ActivateBestChainStep(fSkipdpow, state, pindexMostWork, pblock && pblock->GetHash() == pindexMostWork->GetBlockHash() ? pblock : NULL))
                 return false;
             pindexNewTip = chainActive.Tip();
@@ -5249,10 +5611,25 @@ bool ActivateBestChain(bool fSkipdpow, CValidationState &state, bool fNotifyUI,
                     LOCK(cs_main);
                     ht = chainActive.Height();
                 }
+                if (pcmpctblock && pcmpctblock->header.GetHash() != hashNewTip)
+                    pcmpctblock.reset();
+                CInv inv(MSG_BLOCK, hashNewTip);
                 LOCK(cs_vNodes);
                 for(CNode* pnode : vNodes)
                     if (ht > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                        pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                    {
+                        if (pcmpctblock && pnode->fPreferHeaderAndIDs) {
+                            bool fKnown;
+                            {
+                                LOCK(pnode->cs_inventory);
+                                fKnown = !pnode->setInventoryKnown.insert(inv).second;
+                            }
+                            if (!fKnown)
+                                pnode->PushMessage(NetMsgType::CMPCTBLOCK, *pcmpctblock);
+                        } else {
+                            pnode->PushInventory(inv);
+                        }
+                    }
             }
             // Notify external listeners about the new tip.
             GetMainSignals().UpdatedBlockTip(pindexNewTip);
@@ -5584,7 +5961,8 @@ bool FindBlockPos(int32_t tmpflag,CValidationState &state, CDiskBlockPos &pos, u
         pos.nFile = nFile + tmpflag*TMPFILE_START;
         pos.nPos = (*ptr)[nFile].nSize;
     }
-    if (nFile != *lastfilep) {
+    // Reindex may hand in known blocks from any file, the last file only moves forward
+    if (nFile != *lastfilep && (!fKnown || nFile > *lastfilep)) {
         if (!fKnown) {
             LogPrintf("Leaving block file %i: %s\n", nFile, (*ptr)[nFile].ToString());
         }
@@ -6069,7 +6447,7 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
     return true;
 }
 
-bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState& state, CBlockIndex * const pindexPrev)
+bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState& state, CBlockIndex * const pindexPrev, bool fCacheSaplingBundles)
 {
     const int nHeight = pindexPrev == NULL ? 0 : pindexPrev->nHeight + 1;
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -6115,7 +6493,7 @@ bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState
     }
 
     // Check transaction contextually against consensus rules at block height
-    if (!ContextualCheckTransactionMultithreaded(slowflag,vptx,pindexPrev, state, nHeight, 100)) {
+    if (!ContextualCheckTransactionMultithreaded(slowflag,vptx,pindexPrev, state, nHeight, 100, IsInitialBlockDownload, 1, fCacheSaplingBundles)) {
         return false; // Failure reason has been set in validation state object
     }
 
@@ -6526,7 +6904,8 @@ bool TestBlockValidity(CValidationState &state, const CBlock& block, CBlockIndex
     {
         return false;
     }
-    if (!ContextualCheckBlock(0,block, state, pindexPrev))
+    // Block templates must not evict the cached bundles of the transactions they include
+    if (!ContextualCheckBlock(0,block, state, pindexPrev, true))
     {
         return false;
     }
@@ -6619,6 +6998,7 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMaps.Erase(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -6793,6 +7173,7 @@ bool static LoadBlockIndexDB()
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
+    CThreadPool& pool = GetProcessingThreadPool();
     vector<pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
     for(const auto& item : mapBlockIndex)
@@ -6800,15 +7181,32 @@ bool static LoadBlockIndexDB()
         CBlockIndex* pindex = item.second;
         vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    ParallelSort(pool, vSortedByHeight.begin(), vSortedByHeight.end(), std::less<pair<int, CBlockIndex*> >());
+
+    // The per block proofs are independent, only their running sum has to follow the chain
+    vector<arith_uint256> vBlockProof(vSortedByHeight.size());
+    {
+        vector<std::future<void> > vFutures;
+        for (const auto& chunk : PartitionEvenly(vSortedByHeight.size(), std::max(pool.Size(), 1))) {
+            vFutures.emplace_back(pool.Submit([&vSortedByHeight, &vBlockProof, chunk]() {
+                for (size_t i = chunk.first; i < chunk.second; i++) {
+                    vBlockProof[i] = GetBlockProof(*vSortedByHeight[i].second);
+                }
+            }));
+        }
+        for (auto& future : vFutures) {
+            pool.Wait(future);
+        }
+    }
 
     uiInterface.ShowProgress(_("Loading block index DB..."), 0, false);
     int cur_height_num = 0;
+    int nLastProgress = 0;
 
     for(const auto& item : vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + vBlockProof[cur_height_num];
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
         if (pindex->nTx > 0) {
@@ -6885,7 +7283,11 @@ bool static LoadBlockIndexDB()
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
 
-        uiInterface.ShowProgress(_("Loading block index DB..."), (int)((double)(cur_height_num*100)/(double)(vSortedByHeight.size())), false);
+        int nProgress = (int)((double)(cur_height_num*100)/(double)(vSortedByHeight.size()));
+        if (nProgress != nLastProgress) {
+            uiInterface.ShowProgress(_("Loading block index DB..."), nProgress, false);
+            nLastProgress = nProgress;
+        }
         cur_height_num++;
     }
 
@@ -7292,6 +7694,7 @@ void UnloadBlockIndex()
     vinfoBlockFile.clear();
     tmpBlockFiles.clear();
     nLastBlockFile = 0;
+    blockFileMaps.Clear();
     nBlockSequenceId = 1;
     mapBlockSource.clear();
     mapBlocksInFlight.clear();
@@ -7504,6 +7907,175 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
     return nLoaded > 0;
 }
 
+namespace {
+
+/** Where a block was found in a block file, and the hashes needed to order it */
+struct CReindexBlock {
+    uint256 hash;
+    uint256 hashPrev;
+    CDiskBlockPos pos;
+};
+
+/**
+ * Find the blocks in a block file. Like LoadExternalBlockFile, this scans
+ * for the message start, so garbage between blocks is skipped, but only the
+ * header of each block is deserialized.
+ */
+std::vector<CReindexBlock> ScanBlockFile(int nFile)
+{
+    std::vector<CReindexBlock> vBlocks;
+    CDiskBlockPos pos(nFile, 0);
+    FILE* fileIn = OpenBlockFile(pos, true);
+    if (!fileIn)
+        return vBlocks;
+
+    try {
+        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE(10000000), MAX_BLOCK_SIZE(10000000)+8, SER_DISK, CLIENT_VERSION);
+        std::vector<char> vSkip;
+        uint64_t nRewind = blkdat.GetPos();
+        while (!blkdat.eof() && !ShutdownRequested()) {
+            blkdat.SetPos(nRewind);
+            nRewind++; // start one byte further next time, in case of failure
+            blkdat.SetLimit(); // remove former limit
+            unsigned int nSize = 0;
+            try {
+                // locate a header
+                unsigned char buf[MESSAGE_START_SIZE];
+                blkdat.FindByte(Params().MessageStart()[0]);
+                nRewind = blkdat.GetPos()+1;
+                blkdat >> FLATDATA(buf);
+                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                    continue;
+                // read size
+                blkdat >> nSize;
+                if (nSize < 80 || nSize > MAX_BLOCK_SIZE(10000000))
+                    continue;
+            } catch (const std::exception&) {
+                // no valid block header found; don't complain
+                break;
+            }
+            try {
+                uint64_t nBlockPos = blkdat.GetPos();
+                blkdat.SetLimit(nBlockPos + nSize);
+                CBlockHeader header;
+                blkdat >> header;
+                // Read past the transactions, to be sure the whole block is there
+                vSkip.resize(nBlockPos + nSize - blkdat.GetPos());
+                if (!vSkip.empty())
+                    blkdat.read(&vSkip[0], vSkip.size());
+                nRewind = blkdat.GetPos();
+                vBlocks.push_back({header.GetHash(), header.hashPrevBlock, CDiskBlockPos(nFile, nBlockPos)});
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    return vBlocks;
+}
+
+} // anon namespace
+
+bool ReindexBlockFiles()
+{
+    const CChainParams& chainparams = Params();
+    CThreadPool& pool = GetProcessingThreadPool();
+    int64_t nStart = GetTimeMillis();
+
+    // Find the blocks in every file, one file per task
+    std::vector<std::future<std::vector<CReindexBlock>>> vFutures;
+    for (int nFile = 0; boost::filesystem::exists(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk")); nFile++) {
+        vFutures.emplace_back(pool.Submit([nFile]() { return ScanBlockFile(nFile); }));
+    }
+    std::vector<CReindexBlock> vBlocks;
+    for (size_t i = 0; i < vFutures.size(); i++) {
+        std::vector<CReindexBlock> vFileBlocks = pool.Wait(vFutures[i]);
+        LogPrintf("Reindexing block file blk%05u.dat, %u blocks\n", (unsigned int)i, vFileBlocks.size());
+        vBlocks.insert(vBlocks.end(), vFileBlocks.begin(), vFileBlocks.end());
+    }
+    // The scans stop early on shutdown. Leave by interruption like the loop
+    // below, so ThreadImport does not clear the reindex flag after a partial
+    // pass.
+    if (ShutdownRequested())
+        throw boost::thread_interrupted();
+
+    // Order the blocks parents first, walking the header tree breadth first
+    // from the blocks whose parent is not in the files: the genesis block, or
+    // blocks already in the index.
+    std::unordered_map<uint256, size_t, BlockHasher> mapFound;
+    std::unordered_multimap<uint256, size_t, BlockHasher> mapChildren;
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        if (mapFound.emplace(vBlocks[i].hash, i).second)
+            mapChildren.emplace(vBlocks[i].hashPrev, i);
+    }
+    std::vector<size_t> vOrder;
+    {
+        LOCK(cs_main);
+        for (const auto& found : mapFound) {
+            const CReindexBlock& block = vBlocks[found.second];
+            if (mapFound.count(block.hashPrev))
+                continue;
+            if (block.hash == chainparams.GetConsensus().hashGenesisBlock || mapBlockIndex.count(block.hashPrev))
+                vOrder.push_back(found.second);
+        }
+    }
+    for (size_t i = 0; i < vOrder.size(); i++) {
+        auto range = mapChildren.equal_range(vBlocks[vOrder[i]].hash);
+        for (auto it = range.first; it != range.second; it++)
+            vOrder.push_back(it->second);
+    }
+    if (vOrder.size() < mapFound.size())
+        LogPrintf("%s: skipping %u blocks with unknown parents\n", __func__, mapFound.size() - vOrder.size());
+    LogPrintf("%s: found %u blocks in %u files in %dms\n", __func__, vOrder.size(), vFutures.size(), GetTimeMillis() - nStart);
+
+    // Read blocks ahead on the pool, and process them in order on this thread
+    const size_t nReadAhead = 4 * std::max(pool.Size(), 1);
+    std::deque<std::future<std::shared_ptr<CBlock>>> qReads;
+    size_t nNextRead = 0;
+    int nLoaded = 0;
+    for (size_t i = 0; i < vOrder.size(); i++) {
+        boost::this_thread::interruption_point();
+
+        while (nNextRead < vOrder.size() && nNextRead < i + nReadAhead) {
+            const CReindexBlock& next = vBlocks[vOrder[nNextRead++]];
+            qReads.push_back(pool.Submit([next]() {
+                std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+                if (!ReadBlockFromDisk(0, *block, next.pos, 0) || block->GetHash() != next.hash)
+                    return std::shared_ptr<CBlock>();
+                return block;
+            }));
+        }
+        std::shared_ptr<CBlock> block = pool.Wait(qReads.front());
+        qReads.pop_front();
+
+        CReindexBlock& entry = vBlocks[vOrder[i]];
+        if (!block) {
+            LogPrintf("%s: unable to read block %s at %s\n", __func__, entry.hash.ToString(), entry.pos.ToString());
+            continue;
+        }
+
+        bool fHave;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(entry.hash);
+            fHave = mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+        }
+        if (!fHave) {
+            CValidationState state;
+            if (ProcessNewBlock(0,0,state, NULL, block.get(), true, &entry.pos))
+                nLoaded++;
+            if (state.IsError())
+                break;
+        }
+        NotifyHeaderTip();
+    }
+
+    LogPrintf("Reindexed %i blocks in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
+
 void static CheckBlockIndex()
 {
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -7805,14 +8377,12 @@ bool static AlreadyHave(const CInv& inv) REQUIRES(cs_main)
     return true;
 }
 
-void static ProcessGetData(CNode* pfrom)
+void ProcessGetData(CNode* pfrom)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
 
     vector<CInv> vNotFound;
 
-    LOCK(cs_main);
-
     while (it != pfrom->vRecvGetData.end()) {
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
@@ -7823,78 +8393,126 @@ void static ProcessGetData(CNode* pfrom)
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
             {
-                bool send = false;
-                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end())
+                // Only the decision whether to send is made under cs_main, the
+                // block is read from disk and sent without holding it.
+                const CBlockIndex* pindex = NULL;
+                CDiskBlockPos pos;
+                int nHeight = 0;
+                bool fCompact = false;
+                bool fContinue = false;
+                uint256 hashTip;
                 {
-                    if (chainActive.Contains(mi->second)) {
-                        send = true;
-                    } else {
-                        static const int nOneMonth = 30 * 24 * 60 * 60;
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a month older (both in time, and in
-                        // best equivalent proof of work) than the best header chain we know about.
-                        send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                        (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
-                        (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, Params().GetConsensus()) < nOneMonth);
-                        if (!send) {
-                            LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
+                    LOCK(cs_main);
+                    bool send = false;
+                    BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+                    if (mi != mapBlockIndex.end())
+                    {
+                        if (chainActive.Contains(mi->second)) {
+                            send = true;
+                        } else {
+                            static const int nOneMonth = 30 * 24 * 60 * 60;
+                            // To prevent fingerprinting attacks, only send blocks outside of the active
+                            // chain if they are valid, and no more than a month older (both in time, and in
+                            // best equivalent proof of work) than the best header chain we know about.
+                            send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
+                            (pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() < nOneMonth) &&
+                            (GetBlockProofEquivalentTime(*pindexBestHeader, *mi->second, *pindexBestHeader, Params().GetConsensus()) < nOneMonth);
+                            if (!send) {
+                                LogPrintf("%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
+                            }
                         }
                     }
+                    // Pruned nodes may have deleted the block, so check whether
+                    // it's available before trying to send.
+                    if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
+                    {
+                        pindex = mi->second;
+                        pos = pindex->GetBlockPos();
+                        nHeight = pindex->nHeight;
+                        // The peer is unlikely to have the transactions of an older block
+                        // in its mempool, so send those in full.
+                        fCompact = pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+                        fContinue = (inv.hash == pfrom->hashContinue);
+                        if (fContinue)
+                            hashTip = chainActive.Tip()->GetBlockHash();
+                    }
                 }
-                // Pruned nodes may have deleted the block, so check whether
-                // it's available before trying to send.
-                if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
+                if (pindex != NULL)
                 {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second,1))
+                    if (inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fCompact))
                     {
-                        assert(!"cannot load block from disk");
+                        // A full block is sent as it is stored on disk, without deserializing it
+                        std::shared_ptr<const CDataStream> ssBlock = GetServedBlock(inv.hash, pos);
+                        if (ssBlock)
+                        {
+                            pfrom->PushMessage(NetMsgType::BLOCK, *ssBlock);
+                        }
+                        else
+                        {
+                            // The block may have been pruned since cs_main was released
+                            LOCK(cs_main);
+                            if (pindex->nStatus & BLOCK_HAVE_DATA)
+                                assert(!"cannot load block from disk");
+                        }
                     }
                     else
                     {
-                        if (inv.type == MSG_BLOCK)
+                        // Send block from disk
+                        CBlock block;
+                        if (!ReadBlockFromDisk(nHeight, block, pos, 1) || block.GetHash() != inv.hash)
                         {
-                            //uint256 hash; int32_t z;
-                            //hash = block.GetHash();
-                            //for (z=31; z>=0; z--)
-                            //    fprintf(stderr,"%02x",((uint8_t *)&hash)[z]);
-                            //fprintf(stderr," send block %d\n",komodo_block2height(&block));
-                            pfrom->PushMessage(NetMsgType::BLOCK, block);
+                            // The block may have been pruned since cs_main was released
+                            LOCK(cs_main);
+                            if (pindex->nStatus & BLOCK_HAVE_DATA)
+                                assert(!"cannot load block from disk");
                         }
-                        else // MSG_FILTERED_BLOCK)
+                        else
                         {
-                            LOCK(pfrom->cs_filter);
-                            if (pfrom->pfilter)
+                            if (inv.type == MSG_CMPCT_BLOCK)
                             {
-                                CMerkleBlock merkleBlock(block, *pfrom->pfilter);
-                                pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
-                                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                                // This avoids hurting performance by pointlessly requiring a round-trip
-                                // Note that there is currently no way for a node to request any single transactions we didn't send here -
-                                // they must either disconnect and retry or request the full block.
-                                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                                // however we MUST always provide at least what the remote peer needs
-                                typedef std::pair<unsigned int, uint256> PairType;
-                                BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
-                                    pfrom->PushMessage(NetMsgType::TX, block.vtx[pair.first]);
+                                CBlockHeaderAndShortTxIDs cmpctblock(block);
+                                pfrom->PushMessage(NetMsgType::CMPCTBLOCK, cmpctblock);
+                            }
+                            else // MSG_FILTERED_BLOCK)
+                            {
+                                LOCK(pfrom->cs_filter);
+                                if (pfrom->pfilter)
+                                {
+                                    CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                                    pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
+                                    // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                                    // This avoids hurting performance by pointlessly requiring a round-trip
+                                    // Note that there is currently no way for a node to request any single transactions we didn't send here -
+                                    // they must either disconnect and retry or request the full block.
+                                    // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                                    // however we MUST always provide at least what the remote peer needs
+                                    typedef std::pair<unsigned int, uint256> PairType;
+                                    BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
+                                    {
+                                        bool fKnown;
+                                        {
+                                            LOCK(pfrom->cs_inventory);
+                                            fKnown = pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second));
+                                        }
+                                        if (!fKnown)
+                                            pfrom->PushMessage(NetMsgType::TX, block.vtx[pair.first]);
+                                    }
+                                }
+                                // else
+                                // no response
                             }
-                            // else
-                            // no response
                         }
                     }
                     // Trigger the peer node to send a getblocks request for the next batch of inventory
-                    if (inv.hash == pfrom->hashContinue)
+                    if (fContinue)
                     {
                         // Bypass PushInventory, this must send even if redundant,
                         // and we want it right after the last block so they don't
                         // wait for other stuff first.
                         vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+                        vInv.push_back(CInv(MSG_BLOCK, hashTip));
                         pfrom->PushMessage(NetMsgType::INV, vInv);
                         pfrom->hashContinue.SetNull();
                     }
@@ -7927,7 +8545,7 @@ void static ProcessGetData(CNode* pfrom)
                 }
             }
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -7954,6 +8572,50 @@ void static ProcessGetData(CNode* pfrom)
 
 void komodo_netevent(std::vector<uint8_t> payload);
 
+/**
+ * The checks of AcceptToMemoryPool that need no chain state, run before
+ * cs_main is taken so that verifying the Sapling proofs of a relayed
+ * transaction does not hold up every other thread. Bundles that pass are
+ * cached, so AcceptToMemoryPool does not verify them a second time.
+ */
+static bool PreCheckRelayedTransaction(const CTransaction& tx, CValidationState& state, uint32_t tiptime, int nextBlockHeight)
+{
+    if (!CheckTransactionWithoutProofVerification(tiptime, tx, state))
+        return false;
+
+    std::vector<const CTransaction*> vptx;
+    vptx.emplace_back(&tx);
+    // Same DoS level as AcceptToMemoryPool uses for relayed transactions
+    return ContextualCheckTransactionMultithreaded(0, vptx, 0, state, nextBlockHeight, 10, IsInitialBlockDownload, 1, true);
+}
+
+/** Validate a block a peer sent us, in full or rebuilt from a compact block. */
+void static ProcessBlockFromPeer(CNode* pfrom, CBlock& block, bool fForceProcessing)
+{
+    CInv inv(MSG_BLOCK, block.GetHash());
+    LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
+
+    pfrom->AddInventoryKnown(inv);
+
+    CValidationState state;
+    ProcessNewBlock(0,0,state, pfrom, &block, fForceProcessing, NULL);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage(NetMsgType::REJECT, string(NetMsgType::BLOCK), state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+        return;
+    }
+
+    // A peer that was first to give us our new tip is a good source for the next one
+    LOCK(cs_main);
+    if (!IsInitialBlockDownload() && chainActive.Tip()->GetBlockHash() == inv.hash)
+        MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom);
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     int32_t nProtocolVersion;
@@ -8153,6 +8815,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             State(pfrom->GetId())->fCurrentlyConnected = true;
             AddressCurrentlyConnected(State(pfrom->GetId())->address);
         }
+
+        // Tell the peer we can relay compact blocks, without asking for
+        // unsolicited announcements yet (BIP152 low bandwidth mode).
+        if (!KOMODO_NSPV_SUPERLITE)
+            pfrom->PushMessage(NetMsgType::SENDCMPCT, false, CMPCTBLOCKS_VERSION);
     }
 
 
@@ -8177,6 +8844,18 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         return true;
     }
 
+    else if (strCommand == NetMsgType::SENDCMPCT)
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        // Versions we do not know are ignored, as BIP152 asks
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            pfrom->fSupportsCompactBlocks = true;
+            pfrom->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
     else if (strCommand == NetMsgType::ADDR || strCommand == NetMsgType::ADDRV2)
     {
         int stream_version = vRecv.GetVersion();
@@ -8449,9 +9128,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     // not a direct successor.
                     pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), inv.hash);
                     CNodeState *nodestate = State(pfrom->GetId());
-                    if (chainActive.Tip()->GetBlockTime() > GetTime() - chainparams.GetConsensus().nPowTargetSpacing * 20 &&
+                    if (CanDirectFetch(chainparams.GetConsensus()) &&
                         nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-                        vToFetch.push_back(inv);
+                        // Near the tip most of a new block's transactions are already in our mempool
+                        vToFetch.push_back(pfrom->fSupportsCompactBlocks ? CInv(MSG_CMPCT_BLOCK, inv.hash) : inv);
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
                         MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
@@ -8487,8 +9167,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         if ((fDebug && vInv.size() > 0) || (vInv.size() == 1))
             LogPrint("net", "received getdata for: %s peer=%d\n", vInv[0].ToString(), pfrom->id);
 
+        // Served by a getdata thread of the message handler, see ThreadMessageHandler
         pfrom->vRecvGetData.insert(pfrom->vRecvGetData.end(), vInv.begin(), vInv.end());
-        ProcessGetData(pfrom);
     }
 
 
@@ -8570,10 +9250,11 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             pfrom->lasthdrsreq = (int32_t)(pindex ? pindex->nHeight : -1);
             for (; pindex; pindex = chainActive.Next(pindex))
             {
+                // Trimmed solutions are read back from the block index db, do it once per header
                 CBlockHeader h = pindex->GetBlockHeader();
                 //printf("size.%i, solution size.%i\n", (int)sizeof(h), (int)h.nSolution.size());
                 //printf("hash.%s prevhash.%s nonce.%s\n", h.GetHash().ToString().c_str(), h.hashPrevBlock.ToString().c_str(), h.nNonce.ToString().c_str());
-                vHeaders.push_back(pindex->GetBlockHeader());
+                vHeaders.push_back(h);
                 if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
                     break;
             }
@@ -8595,15 +9276,31 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
+        CValidationState state;
+        bool fPreChecked = true;
+        {
+            bool fAlreadyHave;
+            uint32_t tiptime;
+            int nextBlockHeight;
+            {
+                LOCK(cs_main);
+                fAlreadyHave = AlreadyHave(inv);
+                nextBlockHeight = chainActive.Height() + 1;
+                tiptime = (nextBlockHeight <= 1 || chainActive.Tip() == 0) ? (uint32_t)time(NULL) : (uint32_t)chainActive.Tip()->nTime;
+            }
+            // A failure is handled below like a rejection by AcceptToMemoryPool
+            if (!fAlreadyHave)
+                fPreChecked = PreCheckRelayedTransaction(tx, state, tiptime, nextBlockHeight);
+        }
+
         LOCK(cs_main);
 
         bool fMissingInputs = false;
-        CValidationState state;
 
         pfrom->setAskFor.erase(inv.hash);
         mapAlreadyAskedFor.erase(inv);
 
-        if (!AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs))
+        if (fPreChecked && !AlreadyHave(inv) && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs))
         {
             mempool.check(pcoinsTip);
             RelayTransaction(tx);
@@ -8814,33 +9511,196 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         CheckBlockIndex();
     }
 
-    else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    else if (strCommand == NetMsgType::GETBLOCKTXN)
     {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            // An old block is served in full, going through the same checks as a getdata for it
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            return true;
+        }
+
         CBlock block;
-        vRecv >> block;
+        if (!ReadBlockFromDisk(block, it->second, 1))
+            assert(!"cannot load block from disk");
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+                return true;
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage(NetMsgType::BLOCKTXN, resp);
+    }
 
-        CInv inv(MSG_BLOCK, block.GetHash());
-        LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
 
-        pfrom->AddInventoryKnown(inv);
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+                // Doesn't connect (or is genesis), fetch the headers in between first
+                if (!IsInitialBlockDownload())
+                    pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256());
+                return true;
+            }
+
+            CBlockIndex *pindex = NULL;
+            CValidationState state;
+            int32_t futureblock = 0;
+            if (!AcceptBlockHeader(&futureblock, cmpctblock.header, state, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS) && futureblock == 0) {
+                    if (nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
+                    LogPrintf("Peer %d sent us invalid header via cmpctblock\n", pfrom->id);
+                    return true;
+                }
+            }
+            if (pindex == NULL)
+                return true;
+
+            const uint256 hash = pindex->GetBlockHash();
+            LogPrint("net", "received cmpctblock %s peer=%d\n", hash.ToString(), pfrom->id);
+            pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hash));
+            UpdateBlockAvailability(pfrom->GetId(), hash);
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(hash);
+            bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
+
+            if (pindex->nStatus & BLOCK_HAVE_DATA) // Nothing to do here
+                return true;
+
+            if (pindex->nChainWork <= chainActive.Tip()->nChainWork || // We know something better
+                    pindex->nTx != 0) { // We had this block at some point, but pruned it
+                if (fAlreadyInFlight) {
+                    // We requested this block for some reason, but our mempool will probably be useless
+                    // so we just grab the block via normal getdata
+                    std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                    pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                }
+                return true;
+            }
+
+            // If we're not close to tip yet, give up and let parallel block fetch work its magic
+            if (!fAlreadyInFlight && !CanDirectFetch(chainparams.GetConsensus()))
+                return true;
+
+            // Only rebuild blocks that would extend our tip, or nearly so, and
+            // that are not already being fetched from another peer.
+            CNodeState *nodestate = State(pfrom->GetId());
+            if (pindex->nHeight > chainActive.Height() + 2)
+                return true;
+            if (fAlreadyInFlight ? blockInFlightIt->second.first != pfrom->GetId() : nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER)
+                return true;
+
+            list<QueuedBlock>::iterator queuedBlockIt = fAlreadyInFlight ? blockInFlightIt->second.second :
+                MarkBlockAsInFlight(pfrom->GetId(), hash, chainparams.GetConsensus(), pindex);
+            if (queuedBlockIt->partialBlock) // Already rebuilding it from an earlier cmpctblock
+                return true;
+
+            queuedBlockIt->partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+            PartiallyDownloadedBlock& partialBlock = *queuedBlockIt->partialBlock;
+            ReadStatus status = partialBlock.InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(hash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Duplicate short IDs, the block is in flight already, so just request it
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            req.blockhash = hash;
+            req.indexes = partialBlock.GetMissingIndexes();
+            if (!req.indexes.empty()) {
+                pfrom->PushMessage(NetMsgType::GETBLOCKTXN, req);
+                return true;
+            }
+
+            // Everything came from the mempool
+            if (partialBlock.FillBlock(block, std::vector<CTransaction>()) != READ_STATUS_OK) {
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, hash));
+                pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                return true;
+            }
+            fBlockReconstructed = true;
+        }
+
+        if (fBlockReconstructed)
+            ProcessBlockFromPeer(pfrom, block, false);
+    }
+
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        {
+            LOCK(cs_main);
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator it = mapBlocksInFlight.find(resp.blockhash);
+            if (it == mapBlocksInFlight.end() || !it->second.second->partialBlock ||
+                    it->second.first != pfrom->GetId()) {
+                LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            ReadStatus status = it->second.second->partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided with a mempool transaction, fall back to the full block
+                std::vector<CInv> vInv(1, CInv(MSG_BLOCK, resp.blockhash));
+                pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                return true;
+            }
+        }
+
+        ProcessBlockFromPeer(pfrom, block, false);
+    }
+
+
+    else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlock block;
+        vRecv >> block;
 
-        CValidationState state;
         // Process all blocks from whitelisted peers, even if not requested,
         // unless we're still syncing with the network.
         // Such an unrequested block may still be processed, subject to the
         // conditions in AcceptBlock().
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
-        ProcessNewBlock(0,0,state, pfrom, &block, forceProcessing, NULL);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            pfrom->PushMessage(NetMsgType::REJECT, strCommand, state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-        }
-
+        ProcessBlockFromPeer(pfrom, block, forceProcessing);
     }
 
 
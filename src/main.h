@@ -86,6 +86,10 @@ static const unsigned int MAX_STANDARD_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 static const unsigned int DEFAULT_MIN_RELAY_TX_FEE = 100;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -blockservecache, the size in megabytes of the cache of blocks recently served to peers */
+static const int64_t DEFAULT_BLOCK_SERVE_CACHE = 32;
+/** Default for -parallelreindex */
+static const bool DEFAULT_PARALLEL_REINDEX = true;
 /** Default for -txexpirydelta, in number of blocks */
 static const unsigned int DEFAULT_TX_EXPIRY_DELTA = 200;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -106,6 +110,13 @@ static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 160;
+/** Maximum depth of blocks we're willing to serve as compact blocks to peers
+ *  when requested. For older blocks, a regular BLOCK response will be sent. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth of blocks we're willing to respond to GETBLOCKTXN requests for. */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Number of peers we ask to announce new blocks with "cmpctblock" right away (BIP152 high bandwidth mode). */
+static const unsigned int MAX_CMPCTBLOCK_HB_PEERS = 3;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
@@ -113,6 +124,8 @@ static const unsigned int MAX_HEADERS_RESULTS = 160;
 static unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 15 * 60;
+/** Number of modified block index entries that triggers a block index write, so new headers do not keep their solutions in memory for long. */
+static const unsigned int DIRTY_BLOCK_INDEX_WRITE_THRESHOLD = 20000;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
 /** Time to wait (in seconds) between writing wallet witness data to disk. */
@@ -236,6 +249,12 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/**
+ * Rebuild the block index from the blk files. The files are scanned in
+ * parallel, then the blocks are processed parents first. Throws
+ * boost::thread_interrupted if shutdown interrupts the pass.
+ */
+bool ReindexBlockFiles();
 /**
  * Initialize a new block tree database + block data on disk
  * @returns true on success
@@ -253,6 +272,8 @@ bool LoadBlockIndex(bool reindex);
 void UnloadBlockIndex();
 /** Process protocol messages received from a given node */
 bool ProcessMessages(CNode* pfrom);
+/** Serve queued "getdata" requests of a given node, with its cs_vRecvMsg held */
+void ProcessGetData(CNode* pfrom);
 /**
  * Send queued protocol messages to be sent to a give node.
  *
@@ -766,9 +787,11 @@ CheckTransationResults ContextualCheckTransactionBindingSigWorker(const std::vec
 CheckTransationResults ContextualCheckTransactionSaplingSpendWorker(const std::vector<const SpendDescription*> vSpend, const std::vector<uint256> vSpendSig, const uint32_t threadNumber);
 //Validate a batch of Sapling output descriptions
 CheckTransationResults ContextualCheckTransactionSaplingOutputWorker(const std::vector<const OutputDescription*> vOutput, const uint32_t threadNumber);
+//Batch validate the Sapling bundles of a set of transactions, returns false if any bundle is invalid
+bool ContextualCheckTransactionSaplingBatch(const std::vector<const CTransaction*> vtx, const std::vector<uint256> vTxSig, const bool cacheStore);
 /** Check a transaction contextually against a set of consensus rules */
 bool ContextualCheckTransactionMultithreaded(int32_t slowflag, const std::vector<const CTransaction*> vptx, CBlockIndex * const pindexPrev, CValidationState &state, int nHeight, int dosLevel,
-                                bool (*isInitBlockDownload)() = IsInitialBlockDownload,int32_t validateprices=1);
+                                bool (*isInitBlockDownload)() = IsInitialBlockDownload,int32_t validateprices=1, bool cacheSaplingBundles=false);
 
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
@@ -872,6 +895,10 @@ bool GetAddressUnspent(uint160 addressHash, int type,
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex,bool checkPOW);
+/** Read the block at pos, for callers that looked the position up under cs_main and read without it */
+bool ReadBlockFromDisk(int32_t height,CBlock& block, const CDiskBlockPos& pos,bool checkPOW);
+/** Read a block as stored on disk, which is also its network serialization, without deserializing it */
+bool ReadRawBlockFromDisk(CDataStream& ssBlock, const CDiskBlockPos& pos);
 bool PruneOneBlockFile(bool tempfile, const int fileNumber);
 
 /** Functions for validating blocks and updating the block tree */
@@ -902,7 +929,7 @@ bool CheckBlock(int32_t *futureblockp,int32_t height,CBlockIndex *pindex,const C
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex *pindexPrev);
-bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState& state, CBlockIndex *pindexPrev);
+bool ContextualCheckBlock(int32_t slowflag,const CBlock& block, CValidationState& state, CBlockIndex *pindexPrev, bool fCacheSaplingBundles = false);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState &state, const CBlock& block, CBlockIndex *pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
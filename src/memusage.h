@@ -20,6 +20,9 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "prevector.h"
+#include "support/allocators/pool.h"
+
 #include <stdlib.h>
 
 #include <map>
@@ -130,6 +133,25 @@ static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// Pooled data structures
+
+template<std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& resource)
+{
+    // Chunks are large, their malloc overhead is negligible
+    return resource.AllocatedChunkBytes() + MallocUsage(sizeof(void*) * resource.NumAllocatedChunks());
+}
+
+/** The nodes of a map using a pool are counted with the pool, which may be shared by several maps. */
+template<typename X, typename Y, typename Z, typename P, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    size_t nBuckets = MallocUsage(sizeof(void*) * m.bucket_count());
+    if (m.get_allocator().resource() == nullptr)
+        return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + nBuckets;
+    return nBuckets;
+}
+
 }
 
 #endif
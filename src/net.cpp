@@ -33,7 +33,9 @@
 #include "scheduler.h"
 #include "ui_interface.h"
 #include "crypto/common.h"
+#include "threadpool.h"
 #include "tls/utiltls.h"
+#include "util/sock.h"
 #include "komodo_defs.h"
 #include "komodo_globals.h"
 #include "notaries_staked.h"
@@ -42,6 +44,9 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
 #endif
 
 #include <boost/filesystem.hpp>
@@ -1493,9 +1498,242 @@ void ThreadNonTLSPoolsCleaner()
 
 #endif // USE_TLS
 
+/** Events wanted on a socket, and the node it belongs to (-1 for listen sockets) */
+struct WantedSocketEvents {
+    Sock::Event nEvents;
+    NodeId nOwner;
+};
+typedef std::unordered_map<SOCKET, WantedSocketEvents> SocketEventsWanted;
+typedef std::unordered_map<SOCKET, Sock::Event> SocketEventsReady;
+
+/** Collect the listen sockets and the events to wait for on each peer socket. */
+static void GenerateSocketEventsWanted(SocketEventsWanted& mapWanted)
+{
+    BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
+        mapWanted[hListenSocket.socket] = {Sock::RECV, -1};
+    }
+
+    LOCK(cs_vNodes);
+    BOOST_FOREACH(CNode* pnode, vNodes)
+    {
+        LOCK(pnode->cs_hSocket);
+
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+
+        // Errors are reported for every socket, even one with no events wanted.
+        //
+        // Implement the following logic:
+        // * If there is data to send, wait for sending data. As this only
+        //   happens when optimistic write failed, we choose to first drain the
+        //   write buffer in this case before receiving more. This avoids
+        //   needlessly queueing received data, if the remote peer is not themselves
+        //   receiving data. This means properly utilizing TCP flow control signaling.
+        // * Otherwise, if there is no (complete) message in the receive buffer,
+        //   or there is space left in the buffer, wait for receiving data.
+        // * (if neither of the above applies, there is certainly one message
+        //   in the receiver buffer ready to be processed).
+        // Together, that means that at least one of the following is always possible,
+        // so we don't deadlock:
+        // * We send some data.
+        // * We wait for data to be received (and disconnect after timeout).
+        // * We process a message in the buffer (message handler thread).
+        Sock::Event nEvents = 0;
+        {
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            if (lockSend && !pnode->vSendMsg.empty())
+                nEvents = Sock::SEND;
+        }
+        if (nEvents == 0) {
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv && (
+                pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+                pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+                nEvents = Sock::RECV;
+        }
+        mapWanted[pnode->hSocket] = {nEvents, pnode->id};
+    }
+}
+
+/** Wait for socket events with select(), used where epoll is not available. */
+static void WaitSocketEventsSelect(const SocketEventsWanted& mapWanted, SocketEventsReady& mapReady, int64_t nTimeoutMs)
+{
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+    std::set<NodeId> setUnselectable;
+
+    for (const auto& wanted : mapWanted) {
+#ifndef WIN32
+        // Only reachable past FD_SETSIZE when epoll could not be set up. Such a
+        // peer would never be serviced, so drop it rather than keep its slot.
+        if (wanted.first >= FD_SETSIZE) {
+            if (wanted.second.nOwner != -1)
+                setUnselectable.insert(wanted.second.nOwner);
+            continue;
+        }
+#endif
+        FD_SET(wanted.first, &fdsetError);
+        if (wanted.second.nEvents & Sock::RECV)
+            FD_SET(wanted.first, &fdsetRecv);
+        if (wanted.second.nEvents & Sock::SEND)
+            FD_SET(wanted.first, &fdsetSend);
+        hSocketMax = max(hSocketMax, wanted.first);
+        have_fds = true;
+    }
+
+    if (!setUnselectable.empty()) {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes) {
+            if (setUnselectable.count(pnode->id)) {
+                LogPrintf("socket of peer=%d is past FD_SETSIZE, disconnecting\n", pnode->id);
+                pnode->fDisconnect = true;
+            }
+        }
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            // Try every socket, the ones in error will show it on recv
+            for (const auto& wanted : mapWanted)
+                mapReady[wanted.first] = Sock::RECV;
+        }
+        MilliSleep(nTimeoutMs);
+        return;
+    }
+
+    for (const auto& wanted : mapWanted) {
+#ifndef WIN32
+        if (wanted.first >= FD_SETSIZE)
+            continue;
+#endif
+        Sock::Event nEvents = 0;
+        if (FD_ISSET(wanted.first, &fdsetRecv))
+            nEvents |= Sock::RECV;
+        if (FD_ISSET(wanted.first, &fdsetSend))
+            nEvents |= Sock::SEND;
+        if (FD_ISSET(wanted.first, &fdsetError))
+            nEvents |= Sock::ERR;
+        if (nEvents)
+            mapReady[wanted.first] = nEvents;
+    }
+}
+
+#ifdef USE_EPOLL
+/**
+ * Level triggered epoll backend for the socket handler.
+ *
+ * The kernel keeps the interest list between rounds, so only sockets whose
+ * wanted events changed cost an epoll_ctl() call, a wakeup costs time in the
+ * number of ready sockets rather than in the highest descriptor, and there
+ * is no FD_SETSIZE cap on the number of peers.
+ */
+class CSocketEventsEpoll
+{
+private:
+    int fdEpoll;
+    /** What is registered per socket. The owner catches a descriptor reused by a new node. */
+    SocketEventsWanted mapRegistered;
+    std::vector<epoll_event> vEvents;
+
+    static uint32_t ToEpollEvents(Sock::Event nEvents)
+    {
+        return ((nEvents & Sock::RECV) ? EPOLLIN : 0) | ((nEvents & Sock::SEND) ? EPOLLOUT : 0);
+    }
+
+public:
+    CSocketEventsEpoll() : fdEpoll(epoll_create1(EPOLL_CLOEXEC))
+    {
+        if (fdEpoll == -1)
+            LogPrintf("epoll_create1 failed, falling back to select(): %s\n", NetworkErrorString(errno));
+    }
+
+    ~CSocketEventsEpoll()
+    {
+        if (fdEpoll != -1)
+            close(fdEpoll);
+    }
+
+    bool IsValid() const { return fdEpoll != -1; }
+
+    void Wait(const SocketEventsWanted& mapWanted, SocketEventsReady& mapReady, int64_t nTimeoutMs)
+    {
+        // Closing a socket already drops it from the epoll set, so failing
+        // to delete one that is gone is expected.
+        for (SocketEventsWanted::iterator it = mapRegistered.begin(); it != mapRegistered.end();) {
+            if (mapWanted.count(it->first) == 0) {
+                epoll_ctl(fdEpoll, EPOLL_CTL_DEL, it->first, nullptr);
+                it = mapRegistered.erase(it);
+            } else {
+                it++;
+            }
+        }
+
+        for (const auto& wanted : mapWanted) {
+            SocketEventsWanted::iterator it = mapRegistered.find(wanted.first);
+            if (it != mapRegistered.end() && it->second.nEvents == wanted.second.nEvents &&
+                it->second.nOwner == wanted.second.nOwner)
+                continue;
+
+            epoll_event event = {};
+            event.events = ToEpollEvents(wanted.second.nEvents);
+            event.data.fd = wanted.first;
+            // A reused descriptor may or may not still be in the set, so try both ways
+            int nOp = (it != mapRegistered.end()) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            if (epoll_ctl(fdEpoll, nOp, wanted.first, &event) == -1 &&
+                epoll_ctl(fdEpoll, nOp == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, wanted.first, &event) == -1) {
+                LogPrint("net", "epoll_ctl for socket %d failed: %s\n", wanted.first, NetworkErrorString(errno));
+                if (it != mapRegistered.end())
+                    mapRegistered.erase(it);
+                continue;
+            }
+            mapRegistered[wanted.first] = wanted.second;
+        }
+
+        vEvents.resize(std::max<size_t>(mapRegistered.size(), 1));
+        int nReady = epoll_wait(fdEpoll, vEvents.data(), vEvents.size(), nTimeoutMs);
+        if (nReady == -1) {
+            if (errno != EINTR) {
+                LogPrintf("socket epoll error %s\n", NetworkErrorString(errno));
+                MilliSleep(nTimeoutMs);
+            }
+            return;
+        }
+
+        for (int i = 0; i < nReady; i++) {
+            Sock::Event nEvents = 0;
+            if (vEvents[i].events & EPOLLIN)
+                nEvents |= Sock::RECV;
+            if (vEvents[i].events & EPOLLOUT)
+                nEvents |= Sock::SEND;
+            if (vEvents[i].events & (EPOLLERR | EPOLLHUP))
+                nEvents |= Sock::ERR;
+            mapReady[vEvents[i].data.fd] = nEvents;
+        }
+    }
+};
+#endif
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+#ifdef USE_EPOLL
+    CSocketEventsEpoll epoll;
+#endif
     while (true)
     {
         //
@@ -1564,94 +1802,26 @@ void ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH(CNode* pnode, vNodes)
-            {
-                LOCK(pnode->cs_hSocket);
-
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signaling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (
-                        pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        SocketEventsWanted mapWanted;
+        GenerateSocketEventsWanted(mapWanted);
+
+        SocketEventsReady mapReady;
+        const int64_t nTimeoutMs = 50; // frequency to poll pnode->vSend
+#ifdef USE_EPOLL
+        if (epoll.IsValid())
+            epoll.Wait(mapWanted, mapReady, nTimeoutMs);
+        else
+#endif
+            WaitSocketEventsSelect(mapWanted, mapReady, nTimeoutMs);
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
-        }
-
         //
         // Accept new connections
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            SocketEventsReady::const_iterator it = mapReady.find(hListenSocket.socket);
+            if (hListenSocket.socket != INVALID_SOCKET && it != mapReady.end() && (it->second & Sock::RECV))
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1671,7 +1841,14 @@ void ThreadSocketHandler()
         {
             boost::this_thread::interruption_point();
 
-            if (tlsmanager.threadSocketHandler(pnode,fdsetRecv,fdsetSend,fdsetError)==-1){
+            Sock::Event nEvents = 0;
+            {
+                LOCK(pnode->cs_hSocket);
+                SocketEventsReady::const_iterator it = mapReady.find(pnode->hSocket);
+                if (pnode->hSocket != INVALID_SOCKET && it != mapReady.end())
+                    nEvents = it->second;
+            }
+            if (tlsmanager.threadSocketHandler(pnode, nEvents & Sock::RECV, nEvents & Sock::SEND, nEvents & Sock::ERR) == -1) {
                 continue;
             }
 
@@ -2043,12 +2220,40 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
+/** Serve the queued getdata requests of a node on a getdata thread. */
+static void ServeGetData(CNode* pnode)
+{
+    try {
+        LOCK(pnode->cs_vRecvMsg);
+        if (!pnode->fDisconnect)
+            g_signals.ProcessGetData(pnode);
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ServeGetData()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ServeGetData()");
+    }
+    pnode->fGetDataQueued = false;
+    {
+        LOCK(cs_vNodes);
+        pnode->Release();
+    }
+    messageHandlerCondition.notify_one();
+}
+
 void ThreadMessageHandler()
 {
     boost::mutex condition_mutex;
     boost::unique_lock<boost::mutex> lock(condition_mutex);
 
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+
+    // Serving getdata reads blocks from disk. Doing that here would make every
+    // peer wait behind one that is fetching old blocks, so queued requests go
+    // to these threads instead. Stopped, after finishing what is queued, when
+    // this thread is interrupted.
+    CThreadPool getDataPool("getdata");
+    getDataPool.Start(GETDATA_THREADS);
+
     while (true)
     {
         vector<CNode*> vNodesCopy;
@@ -2072,10 +2277,27 @@ void ThreadMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            // A getdata thread has the node, its later messages wait so responses stay in order
+            if (pnode->fGetDataQueued)
+                continue;
+
             // Receive messages
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv)
+                if (lockRecv && !pnode->vRecvGetData.empty())
+                {
+                    if (pnode->nSendSize < SendBufferSize())
+                    {
+                        pnode->fGetDataQueued = true;
+                        {
+                            LOCK(cs_vNodes);
+                            pnode->AddRef();
+                        }
+                        getDataPool.Submit([pnode]() { ServeGetData(pnode); });
+                        continue;
+                    }
+                }
+                else if (lockRecv)
                 {
                     if (!g_signals.ProcessMessages(pnode))
                         pnode->CloseSocketDisconnect();
@@ -92,6 +92,8 @@ static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 384;
 /** The period before a network upgrade activates, where connections to upgrading peers are preferred (in blocks). */
 static const int NETWORK_UPGRADE_PEER_PREFERENCE_BLOCK_PERIOD = 24 * 24 * 3;
+/** Number of threads serving queued "getdata" requests, so reading blocks from disk does not hold up the message handler. */
+static const int GETDATA_THREADS = 2;
 
 extern std::atomic<bool> fNetworkActive;
 
@@ -188,6 +190,7 @@ struct CNodeSignals
 {
     boost::signals2::signal<int ()> GetHeight;
     boost::signals2::signal<bool (CNode*), CombinerAll> ProcessMessages;
+    boost::signals2::signal<void (CNode*)> ProcessGetData;
     boost::signals2::signal<bool (CNode*, bool), CombinerAll> SendMessages;
     boost::signals2::signal<void (NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void (NodeId)> FinalizeNode;
@@ -385,6 +388,8 @@ public:
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
+    //! Set while a getdata worker serves vRecvGetData, the message handler leaves the node alone until then
+    std::atomic<bool> fGetDataQueued{false};
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
     uint64_t nRecvBytes;
@@ -433,6 +438,11 @@ public:
      */
     bool m_wants_addrv2{false};
 
+    //! Whether the peer sent "sendcmpct" with a compact block version we speak (BIP152)
+    std::atomic<bool> fSupportsCompactBlocks{false};
+    //! Whether the peer wants new blocks announced with "cmpctblock" instead of "inv"
+    std::atomic<bool> fPreferHeaderAndIDs{false};
+
 protected:
 
     // Denial-of-service detection/prevention
@@ -298,24 +298,51 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/**
+ * What blockToJSON reports about a block's place in the active chain. Read
+ * under cs_main, so the block itself can be serialized without holding it.
+ * The other CBlockIndex fields it reports do not change once the block is
+ * stored.
+ */
+struct BlockChainPosition
 {
-    UniValue result(UniValue::VOBJ);
-    uint256 notarized_hash,notarized_desttxid; int32_t prevMoMheight,notarized_height;
-    notarized_height = komodo_notarized_height(&prevMoMheight,&notarized_hash,&notarized_desttxid);
-    result.push_back(Pair("last_notarized_height", notarized_height));
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
-    int confirmations = -1;
+    int notarizedHeight;
+    int confirmations;
+    int dpowConfirmations;
+    int segid;
+    uint256 nextHash;
+};
+
+/** Call with cs_main held */
+static BlockChainPosition GetBlockChainPosition(const CBlockIndex* blockindex)
+{
+    BlockChainPosition pos;
+    uint256 notarized_hash,notarized_desttxid; int32_t prevMoMheight;
+    pos.notarizedHeight = komodo_notarized_height(&prevMoMheight,&notarized_hash,&notarized_desttxid);
+    pos.confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", komodo_dpowconfs(blockindex->nHeight,confirmations)));
-    result.push_back(Pair("rawconfirmations", confirmations));
+        pos.confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    pos.dpowConfirmations = komodo_dpowconfs(blockindex->nHeight,pos.confirmations);
+    pos.segid = komodo_segid(0,blockindex->nHeight);
+    CBlockIndex *pnext = chainActive.Next(blockindex);
+    if (pnext)
+        pos.nextHash = pnext->GetBlockHash();
+    return pos;
+}
+
+static UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, const BlockChainPosition& pos, bool txDetails)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("last_notarized_height", pos.notarizedHeight));
+    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    result.push_back(Pair("confirmations", pos.dpowConfirmations));
+    result.push_back(Pair("rawconfirmations", pos.confirmations));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
     result.push_back(Pair("height", blockindex->nHeight));
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("segid", (int)komodo_segid(0,blockindex->nHeight)));
+    result.push_back(Pair("segid", pos.segid));
     result.push_back(Pair("finalsaplingroot", block.hashFinalSaplingRoot.GetHex()));
     UniValue txs(UniValue::VARR);
     BOOST_FOREACH(const CTransaction&tx, block.vtx)
@@ -347,12 +374,21 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    if (!pos.nextHash.IsNull())
+        result.push_back(Pair("nextblockhash", pos.nextHash.GetHex()));
     return result;
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    BlockChainPosition pos;
+    {
+        LOCK(cs_main);
+        pos = GetBlockChainPosition(blockindex);
+    }
+    return blockToJSON(block, blockindex, pos, txDetails);
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() != 0)
@@ -892,34 +928,8 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
             + HelpExampleRpc("getblock", "12800")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
 
-    // If height is supplied, find the hash
-    if (strHash.size() < (2 * sizeof(uint256))) {
-        // std::stoi allows characters, whereas we want to be strict
-        regex r("[[:digit:]]+");
-        if (!regex_match(strHash, r)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        int nHeight = -1;
-        try {
-            nHeight = std::stoi(strHash);
-        }
-        catch (const std::exception &e) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        if (nHeight < 0 || nHeight > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
-        }
-        strHash = chainActive[nHeight]->GetBlockHash().GetHex();
-    }
-
-    uint256 hash(uint256S(strHash));
-
     int verbosity = 1;
     if (params.size() > 1) {
         if(params[1].isNum()) {
@@ -933,16 +943,52 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    // Find the block under cs_main, read and serialize it without holding it
+    CBlockIndex* pblockindex;
+    CDiskBlockPos blockPos;
+    BlockChainPosition chainPos;
+    {
+        LOCK(cs_main);
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+        // If height is supplied, find the hash
+        if (strHash.size() < (2 * sizeof(uint256))) {
+            // std::stoi allows characters, whereas we want to be strict
+            regex r("[[:digit:]]+");
+            if (!regex_match(strHash, r)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+            }
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+            int nHeight = -1;
+            try {
+                nHeight = std::stoi(strHash);
+            }
+            catch (const std::exception &e) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+            }
 
-    if(!ReadBlockFromDisk(block, pblockindex,1))
+            if (nHeight < 0 || nHeight > chainActive.Height()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+            }
+            strHash = chainActive[nHeight]->GetBlockHash().GetHex();
+        }
+
+        uint256 hash(uint256S(strHash));
+
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+        pblockindex = mapBlockIndex[hash];
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+        blockPos = pblockindex->GetBlockPos();
+        if (verbosity > 0)
+            chainPos = GetBlockChainPosition(pblockindex);
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(pblockindex->nHeight, block, blockPos, 1) || block.GetHash() != pblockindex->GetBlockHash())
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
     if (verbosity == 0)
@@ -953,7 +999,7 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    return blockToJSON(block, pblockindex, chainPos, verbosity >= 2);
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
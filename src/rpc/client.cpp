@@ -211,17 +211,14 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "zs_listsentbyaddress", 2},
     { "zs_listsentbyaddress", 3},
     { "zs_listsentbyaddress", 4},
-    { "zs_listsentbyaddress", 5},
     { "zs_listreceivedbyaddress", 1},
     { "zs_listreceivedbyaddress", 2},
     { "zs_listreceivedbyaddress", 3},
     { "zs_listreceivedbyaddress", 4},
-    { "zs_listreceivedbyaddress", 5},
     { "zs_listspentbyaddress", 1},
     { "zs_listspentbyaddress", 2},
     { "zs_listspentbyaddress", 3},
     { "zs_listspentbyaddress", 4},
-    { "zs_listspentbyaddress", 5},
 
     { "exportsaplingtree", 0},
     { "getsaplingwitness", 1},
@@ -68,6 +68,65 @@ string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValu
     return reply.write() + "\n";
 }
 
+static void JSONWriteChunked(const UniValue& val, std::string& buf, const std::function<void(const std::string&)>& writeChunk,
+                             size_t nChunkSize)
+{
+    if (val.isArray()) {
+        const std::vector<UniValue>& values = val.getValues();
+        buf += '[';
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0)
+                buf += ',';
+            JSONWriteChunked(values[i], buf, writeChunk, nChunkSize);
+        }
+        buf += ']';
+    } else if (val.isObject()) {
+        const std::vector<std::string>& keys = val.getKeys();
+        const std::vector<UniValue>& values = val.getValues();
+        buf += '{';
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i > 0)
+                buf += ',';
+            buf += UniValue(keys[i]).write();
+            buf += ':';
+            JSONWriteChunked(values[i], buf, writeChunk, nChunkSize);
+        }
+        buf += '}';
+    } else {
+        buf += val.write();
+    }
+
+    if (buf.size() >= nChunkSize) {
+        writeChunk(buf);
+        buf.clear();
+    }
+}
+
+void JSONWriteChunked(const UniValue& val, const std::function<void(const std::string&)>& writeChunk, size_t nChunkSize)
+{
+    std::string buf;
+    buf.reserve(nChunkSize + nChunkSize / 4);
+    JSONWriteChunked(val, buf, writeChunk, nChunkSize);
+    if (!buf.empty())
+        writeChunk(buf);
+}
+
+void JSONRPCReplyChunked(const UniValue& result, const UniValue& error, const UniValue& id,
+                         const std::function<void(const std::string&)>& writeChunk, size_t nChunkSize)
+{
+    // Same layout as JSONRPCReplyObj
+    std::string buf;
+    buf.reserve(nChunkSize + nChunkSize / 4);
+    buf += "{\"result\":";
+    JSONWriteChunked(error.isNull() ? result : NullUniValue, buf, writeChunk, nChunkSize);
+    buf += ",\"error\":";
+    buf += error.write();
+    buf += ",\"id\":";
+    buf += id.write();
+    buf += "}\n";
+    writeChunk(buf);
+}
+
 UniValue JSONRPCError(int code, const string& message)
 {
     printf("JSONRPCError(): %s\n",message.c_str() );
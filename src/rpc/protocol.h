@@ -21,6 +21,7 @@
 #ifndef BITCOIN_RPCPROTOCOL_H
 #define BITCOIN_RPCPROTOCOL_H
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -98,6 +99,22 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+/** Size of the pieces a streamed JSON reply is handed out in */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Write val as compact JSON, the same text as val.write(), passing it to
+ * writeChunk whenever at least nChunkSize bytes are buffered. This avoids
+ * building the whole text as one string; val itself is still held in full,
+ * and a piece grows past nChunkSize when a single scalar or key is longer.
+ */
+void JSONWriteChunked(const UniValue& val, const std::function<void(const std::string&)>& writeChunk,
+                      size_t nChunkSize = JSON_STREAM_CHUNK_SIZE);
+/** Streaming form of JSONRPCReply, without copying result into a reply object */
+void JSONRPCReplyChunked(const UniValue& result, const UniValue& error, const UniValue& id,
+                         const std::function<void(const std::string&)>& writeChunk,
+                         size_t nChunkSize = JSON_STREAM_CHUNK_SIZE);
+
 /** Get name of RPC authentication cookie file */
 boost::filesystem::path GetAuthCookieFile();
 /** Generate a new RPC authentication cookie and write it to disk */
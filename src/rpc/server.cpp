@@ -24,13 +24,16 @@
 #include "key_io.h"
 #include "random.h"
 #include "sync.h"
+#include "threadpool.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "util/strencodings.h"
 #include "asyncrpcqueue.h"
 #include "assetchain.h"
 
+#include <future>
 #include <memory>
+#include <set>
 
 #include <univalue.h>
 #include <unistd.h>
@@ -805,12 +808,89 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/**
+ * Read-only methods that may run concurrently with each other within a batch.
+ * Anything that changes node or wallet state keeps its place in the batch
+ * order, and the calls around it see its effects as if run one by one.
+ */
+static const std::set<std::string> setParallelBatchMethods = {
+    "decoderawtransaction",
+    "decodescript",
+    "getaddressbalance",
+    "getaddressdeltas",
+    "getaddresstxids",
+    "getaddressutxos",
+    "getbestblockhash",
+    "getblock",
+    "getblockcount",
+    "getblockdeltas",
+    "getblockhash",
+    "getblockhashes",
+    "getblockheader",
+    "getrawtransaction",
+    "getspentinfo",
+    "gettxout",
+    "gettxoutproof",
+    "z_gettreestate",
+};
+
+/** Runs the read-only parts of JSON-RPC batches, kept apart from validation work */
+static CThreadPool rpcBatchPool("pirate-rpcbatch");
+
+void StartRPCBatchThreadPool(int nThreads)
+{
+    nThreads = std::max(std::min(nThreads, MAX_RPC_BATCH_THREADS), 0);
+    LogPrint("rpc", "Starting %d RPC batch threads\n", nThreads);
+    rpcBatchPool.Start(nThreads);
+}
+
+void StopRPCBatchThreadPool()
+{
+    rpcBatchPool.Stop();
+}
+
+static bool IsParallelBatchRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& valMethod = find_value(req, "method");
+    return valMethod.isStr() && setParallelBatchMethods.count(valMethod.get_str()) > 0;
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    CThreadPool& pool = rpcBatchPool;
+    std::vector<UniValue> vResults(vReq.size());
+
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        // Run of read-only requests, spread over the batch pool
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsParallelBatchRequest(vReq[nEnd]))
+            nEnd++;
+
+        if (nEnd - reqIdx > 1 && pool.Size() > 0) {
+            std::vector<std::future<void>> vFutures;
+            vFutures.reserve(nEnd - reqIdx);
+            for (size_t i = reqIdx; i < nEnd; i++) {
+                vFutures.emplace_back(pool.Submit([&vReq, &vResults, i]() {
+                    vResults[i] = JSONRPCExecOne(vReq[i]);
+                }));
+            }
+            for (auto& future : vFutures) {
+                pool.Wait(future);
+            }
+        } else {
+            if (nEnd == reqIdx)
+                nEnd++;
+            for (size_t i = reqIdx; i < nEnd; i++)
+                vResults[i] = JSONRPCExecOne(vReq[i]);
+        }
+        reqIdx = nEnd;
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(vResults);
     return ret.write() + "\n";
 }
 
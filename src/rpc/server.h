@@ -214,6 +214,14 @@ extern void EnsureWalletIsUnlockedForReporting();
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+static const int MAX_RPC_BATCH_THREADS = 16;
+
+/** Start the threads that run read-only requests of a batch in parallel, 0 runs batches serially */
+void StartRPCBatchThreadPool(int nThreads);
+void StopRPCBatchThreadPool();
+/** Execute a batch, the replies are in request order */
 std::string JSONRPCExecBatch(const UniValue& vReq);
 UniValue get_async_result(UniValue oOpID);
 
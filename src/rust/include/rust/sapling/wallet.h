@@ -442,6 +442,21 @@ bool sapling_wallet_get_path_for_note(
     unsigned char *path_ret
 );
 
+/**
+ * Writes the Merkle paths of `count` notes, 1065 bytes each, to `paths_ret`
+ * and their common anchor to `anchor_ret`. `cmus` holds the note commitment of
+ * each note. Returns false if any note is untracked or the anchors differ.
+ */
+bool sapling_wallet_get_paths_for_notes(
+    SaplingWalletPtr* wallet,
+    const unsigned char *txids,
+    const size_t *tx_output_idxs,
+    const unsigned char *cmus,
+    const size_t count,
+    unsigned char *paths_ret,
+    unsigned char *anchor_ret
+);
+
 bool get_path_root_with_cm(
     const unsigned char *merkle_path,
     const unsigned char *cm,
@@ -13,7 +13,7 @@ use crate::{
     },
     streams::{
         from_auto_file, from_blake2b_writer, from_buffered_file, from_data, from_hash_writer,
-        from_size_computer, CppStream,
+        from_memory_reader, from_size_computer, CppStream,
     },
     test_harness_ffi::{
         test_only_invalid_sapling_bundle, test_only_replace_sapling_nullifier,
@@ -33,6 +33,7 @@ pub(crate) mod ffi {
         type RustStream = crate::streams::ffi::RustStream;
         type CAutoFile = crate::streams::ffi::CAutoFile;
         type CBufferedFile = crate::streams::ffi::CBufferedFile;
+        type CMemoryReader = crate::streams::ffi::CMemoryReader;
         type CHashWriter = crate::streams::ffi::CHashWriter;
         type CBLAKE2bWriter = crate::streams::ffi::CBLAKE2bWriter;
         type CSizeComputer = crate::streams::ffi::CSizeComputer;
@@ -44,6 +45,7 @@ pub(crate) mod ffi {
         fn from_data(stream: Pin<&mut RustStream>) -> Box<CppStream<'_>>;
         fn from_auto_file(file: Pin<&mut CAutoFile>) -> Box<CppStream<'_>>;
         fn from_buffered_file(file: Pin<&mut CBufferedFile>) -> Box<CppStream<'_>>;
+        fn from_memory_reader(reader: Pin<&mut CMemoryReader>) -> Box<CppStream<'_>>;
         fn from_hash_writer(writer: Pin<&mut CHashWriter>) -> Box<CppStream<'_>>;
         fn from_blake2b_writer(writer: Pin<&mut CBLAKE2bWriter>) -> Box<CppStream<'_>>;
         fn from_size_computer(sc: Pin<&mut CSizeComputer>) -> Box<CppStream<'_>>;
@@ -864,6 +864,71 @@ pub extern "C" fn sapling_wallet_get_path_for_note(
     return false;
 }
 
+/// Computes the Merkle paths of `count` notes in one call. All paths are taken at
+/// checkpoint depth 0, so they share a single anchor, which is written to
+/// `anchor_ret`. Fails if any note is not tracked or any path does not lead to
+/// the same anchor as the others.
+#[no_mangle]
+pub extern "C" fn sapling_wallet_get_paths_for_notes(
+    wallet: *mut Wallet,
+    txids: *const [c_uchar; 32],
+    tx_output_idxs: *const usize,
+    cmus: *const [c_uchar; 32],
+    count: usize,
+    paths_ret: *mut [u8; 1 + 33 * SAPLING_TREE_DEPTH + 8],
+    anchor_ret: *mut [c_uchar; 32],
+) -> bool {
+    let wallet = unsafe { wallet.as_mut() }.expect("Wallet pointer may not be null");
+    if count == 0 {
+        return false;
+    }
+    let txids = unsafe { std::slice::from_raw_parts(txids, count) };
+    let tx_output_idxs = unsafe { std::slice::from_raw_parts(tx_output_idxs, count) };
+    let cmus = unsafe { std::slice::from_raw_parts(cmus, count) };
+    let paths_ret = unsafe { std::slice::from_raw_parts_mut(paths_ret, count) };
+
+    let mut anchor: Option<[u8; 32]> = None;
+    for i in 0..count {
+        let txid = TxId::from_bytes(txids[i]);
+        let position = match wallet.get_position_of_note(&txid, &tx_output_idxs[i]) {
+            Some(position) => position,
+            None => return false,
+        };
+        let path = match wallet
+            .commitment_tree
+            .witness(position, 0)
+            .ok()
+            .and_then(|witness| SaplingPath::from_parts(witness, position).ok())
+        {
+            Some(path) => path,
+            None => return false,
+        };
+
+        let cm = match de_ct(ExtractedNoteCommitment::from_bytes(&cmus[i])) {
+            Some(a) => Node::from_cmu(&a),
+            None => return false,
+        };
+        let root = compute_root_from_witness(cm, path.position(), path.path_elems()).to_bytes();
+        match anchor {
+            Some(a) if a != root => return false,
+            _ => anchor = Some(root),
+        }
+
+        let mut buffer = vec![];
+        if write_merkle_path(&mut buffer, path).is_err() {
+            return false;
+        }
+        match buffer.try_into() {
+            Ok(rust_path_ret) => paths_ret[i] = rust_path_ret,
+            Err(_) => return false,
+        }
+    }
+
+    let anchor_ret = unsafe { &mut *anchor_ret };
+    *anchor_ret = anchor.expect("count is non-zero");
+    true
+}
+
 #[no_mangle]
 pub extern "C" fn sapling_wallet_unmark_transaction_notes(
     wallet: *mut Wallet,
@@ -21,22 +21,19 @@
 #ifndef BITCOIN_SCRIPT_SERVERCHECKER_H
 #define BITCOIN_SCRIPT_SERVERCHECKER_H
 
-#include "script/interpreter.h"
+#include "script/sigcache.h"
 
 #include <vector>
 
 class CPubKey;
 
-class ServerTransactionSignatureChecker : public TransactionSignatureChecker
+/** Signatures are checked against the shared signature cache of CachingTransactionSignatureChecker */
+class ServerTransactionSignatureChecker : public CachingTransactionSignatureChecker
 {
-private:
-    bool store;
-
 public:
-    ServerTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nIn, const CAmount& amount, bool storeIn, const PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nIn, amount, txdataIn), store(storeIn) {}
-    ServerTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nIn, const CAmount& amount, bool storeIn) : TransactionSignatureChecker(txToIn, nIn, amount), store(storeIn) {}
+    ServerTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nIn, const CAmount& amount, bool storeIn, const PrecomputedTransactionData& txdataIn) : CachingTransactionSignatureChecker(txToIn, nIn, amount, storeIn, txdataIn) {}
+    ServerTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nIn, const CAmount& amount, bool storeIn) : CachingTransactionSignatureChecker(txToIn, nIn, amount, storeIn) {}
 
-    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
     int CheckEvalCondition(const CC *cond) const;
 };
 
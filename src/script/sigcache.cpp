@@ -20,6 +20,8 @@
 
 #include "sigcache.h"
 
+#include "cuckoocache.h"
+#include "crypto/sha256.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
@@ -28,10 +30,29 @@
 #undef __cpuid
 #endif
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
+
+#include <algorithm>
+#include <cstring>
 
 namespace {
 
+/**
+ * Entries are salted SHA256 hashes, so any 32 bits of an entry are already
+ * uniformly distributed and can be used directly as one of the cache hashes.
+ */
+class SignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "SignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
@@ -40,68 +61,86 @@ namespace {
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
+    //! Entries are SHA256(nonce || signature hash || public key || signature):
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
     boost::shared_mutex cs_sigcache;
 
 public:
-    bool
-    Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    CSignatureCache()
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        GetRandBytes(nonce.begin(), 32);
+    }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
+    void
+    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
     }
 
-    void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    bool
+    Get(const uint256& entry, const bool erase)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there can be no more than 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
+        // Lookups only flip atomic flags, so script check threads share the lock
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.contains(entry, erase);
+    }
 
+    void Set(const uint256& entry)
+    {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
 
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
-        {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
-        }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
     }
 };
 
+//! Set up by InitSignatureCache before the first signature is checked
+CSignatureCache signatureCache;
+}
+
+void InitSignatureCache()
+{
+    if (!mapArgs.count("-sigcachemaxmb") && mapArgs.count("-maxsigcachesize"))
+        LogPrintf("-maxsigcachesize is deprecated, converting its entry count; use -sigcachemaxmb instead\n");
+    size_t nMaxCacheSize = GetSignatureCacheBytes();
+    size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
+            (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
+}
+
+size_t GetSignatureCacheBytes()
+{
+    const size_t nMiB = (size_t)1 << 20;
+    size_t nBytes;
+    if (!mapArgs.count("-sigcachemaxmb") && mapArgs.count("-maxsigcachesize")) {
+        // -maxsigcachesize used to count entries of each cache, which are now one uint256 apiece
+        int64_t nEntries = std::max(GetArg("-maxsigcachesize", 0), (int64_t)0);
+        nBytes = std::min((size_t)nEntries, (size_t)(MAX_MAX_SIG_CACHE_SIZE / 2) * nMiB / sizeof(uint256)) * sizeof(uint256);
+    } else {
+        int64_t nMaxSize = std::min(std::max(GetArg("-sigcachemaxmb", DEFAULT_MAX_SIG_CACHE_SIZE), (int64_t)0), MAX_MAX_SIG_CACHE_SIZE);
+        nBytes = (size_t)(nMaxSize / 2) * nMiB;
+    }
+    return std::max(nBytes, (size_t)MIN_SIG_CACHE_SIZE * nMiB);
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    uint256 entry;
+    signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(sighash, vchSig, pubkey))
+    // Block validation does not store and erases the entry, it will not be checked again
+    if (signatureCache.Get(entry, !store))
         return true;
 
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
 
     if (store)
-        signatureCache.Set(sighash, vchSig, pubkey);
+        signatureCache.Set(entry);
     return true;
 }
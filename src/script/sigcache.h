@@ -25,6 +25,13 @@
 
 #include <vector>
 
+//! -sigcachemaxmb default in MiB, shared by the signature and Sapling bundle caches
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+//! Largest accepted -sigcachemaxmb in MiB
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+//! Smallest size in MiB given to each of the signature and Sapling bundle caches
+static const int64_t MIN_SIG_CACHE_SIZE = 1;
+
 class CPubKey;
 
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
@@ -33,9 +40,19 @@ private:
     bool store;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, bool storeIn, PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, bool storeIn, const PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amount, bool storeIn) : TransactionSignatureChecker(txToIn, nInIn, amount), store(storeIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Size the signature cache from -sigcachemaxmb, must be called before any script is verified */
+void InitSignatureCache();
+
+/**
+ * Bytes of -sigcachemaxmb given to each of the signature and Sapling bundle caches.
+ * A legacy -maxsigcachesize entry count is converted when -sigcachemaxmb is not set.
+ */
+size_t GetSignatureCacheBytes();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -815,4 +815,55 @@ public:
     }
 };
 
+/** Non-refcounted stream reading from a range of bytes owned by someone else,
+ *  such as a memory mapped file. The bytes must outlive the reader.
+ */
+class CMemoryReader
+{
+private:
+    const int nType;
+    const int nVersion;
+
+    const unsigned char* pbegin;
+    const unsigned char* pend;
+
+public:
+    CMemoryReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, const unsigned char* pendIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), pend(pendIn) {}
+
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+
+    size_t size() const { return pend - pbegin; }
+    bool empty() const { return pbegin == pend; }
+
+    void read_u8(unsigned char* pch, size_t nSize)
+    {
+        read(reinterpret_cast<char*>(pch), nSize);
+    }
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::ignore(): end of data");
+        pbegin += nSize;
+    }
+
+    template<typename T>
+    CMemoryReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+};
+
 #endif // BITCOIN_STREAMS_H
@@ -16,6 +16,10 @@ rust::Box<stream::CppStream> ToRustStream(CBufferedFile& file) {
     return stream::from_buffered_file(file);
 }
 
+rust::Box<stream::CppStream> ToRustStream(CMemoryReader& reader) {
+    return stream::from_memory_reader(reader);
+}
+
 rust::Box<stream::CppStream> ToRustStream(CHashWriter& writer) {
     return stream::from_hash_writer(writer);
 }
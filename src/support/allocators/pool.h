@@ -0,0 +1,208 @@
+// Copyright (c) 2024 The Pirate developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * A memory resource for the nodes of node based containers.
+ *
+ * Memory is taken from the heap in large chunks and carved into blocks. Freed
+ * blocks go into a free list per size (in multiples of ALIGN_BYTES) and are
+ * reused for the next allocation of that size. Nothing is returned to the heap
+ * before the resource is destroyed, so a container that is cleared and refilled
+ * does not fragment the heap, and the memory it holds is known exactly: the
+ * size of its chunks, plus whatever was too big for the pool.
+ *
+ * Allocations larger than MAX_BLOCK_SIZE_BYTES, such as the bucket arrays of
+ * unordered maps, go straight to the heap.
+ *
+ * Not thread safe, like the containers using it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    //! Free blocks hold the pointer to the next free block of the same size
+    struct ListNode {
+        ListNode* next;
+    };
+
+    static constexpr std::size_t ELEM_ALIGN_BYTES = std::max(alignof(ListNode), ALIGN_BYTES);
+    static_assert(ELEM_ALIGN_BYTES >= sizeof(ListNode), "a free block must fit a ListNode");
+    static constexpr std::size_t NUM_FREE_LISTS = (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1;
+
+    const std::size_t m_max_chunk_size_bytes;
+    std::size_t m_next_chunk_size_bytes;
+    std::size_t m_allocated_chunk_bytes = 0;
+    std::array<ListNode*, NUM_FREE_LISTS> m_free_lists{};
+    std::vector<void*> m_allocated_chunks;
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PushFree(void* p, std::size_t num_alignments)
+    {
+        ListNode* node = ::new (p) ListNode{m_free_lists[num_alignments]};
+        m_free_lists[num_alignments] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Keep what is left of the current chunk in the free list of its size
+        if (m_available_memory_it != m_available_memory_end) {
+            const std::size_t remaining = (m_available_memory_end - m_available_memory_it) / ELEM_ALIGN_BYTES;
+            PushFree(m_available_memory_it, remaining);
+        }
+        void* chunk = ::operator new(m_next_chunk_size_bytes, std::align_val_t{ELEM_ALIGN_BYTES});
+        m_allocated_chunks.push_back(chunk);
+        m_allocated_chunk_bytes += m_next_chunk_size_bytes;
+        m_available_memory_it = static_cast<char*>(chunk);
+        m_available_memory_end = m_available_memory_it + m_next_chunk_size_bytes;
+        // Short lived containers only ever take a small chunk, busy ones soon get big ones
+        m_next_chunk_size_bytes = std::min(2 * m_next_chunk_size_bytes, m_max_chunk_size_bytes);
+    }
+
+public:
+    /**
+     * @param max_chunk_size_bytes the size the chunks grow to; the first one
+     *                             holds 16 blocks of the maximum size
+     */
+    explicit PoolResource(std::size_t max_chunk_size_bytes)
+        : m_max_chunk_size_bytes(max_chunk_size_bytes - max_chunk_size_bytes % ELEM_ALIGN_BYTES),
+          m_next_chunk_size_bytes(std::min(16 * NumElemAlignBytes(MAX_BLOCK_SIZE_BYTES) * ELEM_ALIGN_BYTES, m_max_chunk_size_bytes))
+    {
+        assert(m_max_chunk_size_bytes >= NumElemAlignBytes(MAX_BLOCK_SIZE_BYTES) * ELEM_ALIGN_BYTES);
+    }
+
+    PoolResource() : PoolResource(262144) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks) {
+            ::operator delete(chunk, std::align_val_t{ELEM_ALIGN_BYTES});
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes, std::align_val_t{alignment});
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        if (m_free_lists[num_alignments] != nullptr) {
+            ListNode* node = m_free_lists[num_alignments];
+            m_free_lists[num_alignments] = node->next;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if (round_bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p, std::align_val_t{alignment});
+            return;
+        }
+        PushFree(p, NumElemAlignBytes(bytes));
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    //! Memory taken from the heap for chunks, not counting allocations too big for the pool
+    std::size_t AllocatedChunkBytes() const { return m_allocated_chunk_bytes; }
+};
+
+/**
+ * Allocator that takes its memory from a PoolResource. A default constructed
+ * allocator has no resource and uses the heap, so containers using it can
+ * still be declared without one.
+ */
+template <typename T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    // Maps swap and move their allocators along with their nodes
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    PoolAllocator() noexcept : m_resource(nullptr) {}
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        if (m_resource == nullptr) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+        }
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (m_resource == nullptr) {
+            ::operator delete(p, std::align_val_t{alignof(T)});
+            return;
+        }
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
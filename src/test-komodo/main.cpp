@@ -3,14 +3,19 @@
 #include "chainparams.h"
 #include "gtest/gtest.h"
 #include "crypto/common.h"
+#include "script/sigcache.h"
 #include "testutils.h"
 
+#include <rust/bridge.h>
+
 
 int main(int argc, char **argv) {
     assert(init_and_check_sodium() != -1);
     ECC_Start();
     ECCVerifyHandle handle;  // Inits secp256k1 verify context
     SetupNetworking();
+    InitSignatureCache();
+    bundlecache::init(GetSignatureCacheBytes());
     SelectParams(CBaseChainParams::REGTEST);
     chainName = assetchain(); // KMD by default
 
@@ -1,4 +1,5 @@
 #include "primitives/block.h"
+#include "chain.h"
 #include "testutils.h"
 #include "komodo_extern_globals.h"
 #include "consensus/validation.h"
@@ -21,6 +22,37 @@ TEST(test_block, header_size_is_expected) {
     EXPECT_EQ(ss.size(), stream_size);
 }
 
+TEST(test_block, disk_block_index_skips_solution) {
+    CBlockHeader header;
+    header.nTime = 1600000000;
+    header.nSolution = std::vector<unsigned char>(1344, 0x5a);
+    CBlockIndex index(header);
+    index.nHeight = 1234;
+    index.nSaplingValue = 42;
+    index.nStatus = BLOCK_HAVE_DATA;
+    index.nFile = 3;
+    index.nDataPos = 4096;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CDiskBlockIndex(&index, []() { return std::vector<unsigned char>(); });
+    CDataStream ssSkip(ss);
+
+    CDiskBlockIndex full;
+    ss >> full;
+    EXPECT_TRUE(full.HasSolution());
+    EXPECT_EQ(full.GetSolution(), header.nSolution);
+
+    // Fields after the solution are still read when it is skipped
+    CDiskBlockIndex skipped(false);
+    ssSkip >> skipped;
+    EXPECT_TRUE(ssSkip.empty());
+    EXPECT_FALSE(skipped.HasSolution());
+    EXPECT_EQ(skipped.nHeight, 1234);
+    EXPECT_EQ(skipped.nTime, header.nTime);
+    EXPECT_EQ(skipped.nDataPos, 4096);
+    EXPECT_EQ(skipped.nSaplingValue, 42);
+}
+
 TEST(test_block, TestStopAt)
 {
     TestChain chain;
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include "arith_uint256.h"
+#include "blockencodings.h"
+#include "consensus/upgrades.h"
+#include "policy/fees.h"
+#include "streams.h"
+#include "txmempool.h"
+
+namespace TestBlockEncodings {
+
+    CTransaction MakeTx(uint32_t n, bool fCoinbase = false)
+    {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        if (!fCoinbase) {
+            mtx.vin[0].prevout.hash = ArithToUint256(arith_uint256(n + 1));
+            mtx.vin[0].prevout.n = n;
+        }
+        mtx.vin[0].scriptSig = CScript() << n;
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 1000 * (n + 1);
+        return CTransaction(mtx);
+    }
+
+    CBlock MakeBlock(size_t nTx)
+    {
+        CBlock block;
+        block.nTime = 1600000000;
+        block.vtx.push_back(MakeTx(0, true));
+        for (size_t i = 1; i < nTx; i++) {
+            block.vtx.push_back(MakeTx(i));
+        }
+        block.hashMerkleRoot = block.BuildMerkleTree();
+        return block;
+    }
+
+    TEST(TestBlockEncodings, rebuilds_block_from_mempool)
+    {
+        CBlock block = MakeBlock(4);
+
+        CTxMemPool pool(CFeeRate(0));
+        CTxMemPoolEntry entry(block.vtx[2], 0, 0, 0, 0, true, false, SPROUT_BRANCH_ID);
+        pool.addUnchecked(block.vtx[2].GetHash(), entry);
+
+        // Round trip through the wire format
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CBlockHeaderAndShortTxIDs(block);
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        ss >> cmpctblock;
+        EXPECT_EQ(cmpctblock.header.GetHash(), block.GetHash());
+        EXPECT_EQ(cmpctblock.BlockTxCount(), block.vtx.size());
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ASSERT_EQ(partialBlock.InitData(cmpctblock), READ_STATUS_OK);
+        EXPECT_TRUE(partialBlock.IsTxAvailable(0)); // prefilled coinbase
+        EXPECT_FALSE(partialBlock.IsTxAvailable(1));
+        EXPECT_TRUE(partialBlock.IsTxAvailable(2)); // from the mempool
+        EXPECT_FALSE(partialBlock.IsTxAvailable(3));
+        EXPECT_EQ(partialBlock.GetMissingIndexes(), std::vector<uint16_t>({1, 3}));
+
+        // Too few or too many missing transactions is the peer's fault
+        CBlock rebuilt;
+        EXPECT_EQ(partialBlock.FillBlock(rebuilt, {block.vtx[1]}), READ_STATUS_INVALID);
+        EXPECT_EQ(partialBlock.FillBlock(rebuilt, {block.vtx[1], block.vtx[3], block.vtx[2]}), READ_STATUS_INVALID);
+
+        // Wrong transactions show up as a merkle root mismatch
+        EXPECT_EQ(partialBlock.FillBlock(rebuilt, {block.vtx[3], block.vtx[1]}), READ_STATUS_FAILED);
+
+        ASSERT_EQ(partialBlock.FillBlock(rebuilt, {block.vtx[1], block.vtx[3]}), READ_STATUS_OK);
+        EXPECT_EQ(rebuilt.GetHash(), block.GetHash());
+        ASSERT_EQ(rebuilt.vtx.size(), block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            EXPECT_EQ(rebuilt.vtx[i].GetHash(), block.vtx[i].GetHash());
+        }
+    }
+
+    TEST(TestBlockEncodings, prefills_transactions_missing_from_sender_mempool)
+    {
+        CBlock block = MakeBlock(5);
+
+        CTxMemPool senderPool(CFeeRate(0));
+        CTxMemPoolEntry entry(block.vtx[2], 0, 0, 0, 0, true, false, SPROUT_BRANCH_ID);
+        senderPool.addUnchecked(block.vtx[2].GetHash(), entry);
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CBlockHeaderAndShortTxIDs(block, &senderPool);
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        ss >> cmpctblock;
+        EXPECT_EQ(cmpctblock.BlockTxCount(), block.vtx.size());
+
+        CTxMemPool pool(CFeeRate(0));
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ASSERT_EQ(partialBlock.InitData(cmpctblock), READ_STATUS_OK);
+        EXPECT_EQ(partialBlock.GetMissingIndexes(), std::vector<uint16_t>({2}));
+
+        CBlock rebuilt;
+        ASSERT_EQ(partialBlock.FillBlock(rebuilt, {block.vtx[2]}), READ_STATUS_OK);
+        EXPECT_EQ(rebuilt.GetHash(), block.GetHash());
+    }
+
+    class CollidingShortTxIDs : public CBlockHeaderAndShortTxIDs
+    {
+    public:
+        CollidingShortTxIDs(const CBlock& block) : CBlockHeaderAndShortTxIDs(block)
+        {
+            shorttxids[1] = shorttxids[0];
+        }
+    };
+
+    TEST(TestBlockEncodings, requests_transactions_with_colliding_short_ids)
+    {
+        CBlock block = MakeBlock(4);
+
+        CTxMemPool pool(CFeeRate(0));
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            CTxMemPoolEntry entry(block.vtx[i], 0, 0, 0, 0, true, false, SPROUT_BRANCH_ID);
+            pool.addUnchecked(block.vtx[i].GetHash(), entry);
+        }
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        ASSERT_EQ(partialBlock.InitData(CollidingShortTxIDs(block)), READ_STATUS_OK);
+        EXPECT_EQ(partialBlock.GetMissingIndexes(), std::vector<uint16_t>({1, 2}));
+        EXPECT_TRUE(partialBlock.IsTxAvailable(3));
+    }
+
+    TEST(TestBlockEncodings, rejects_empty_compact_block)
+    {
+        CTxMemPool pool(CFeeRate(0));
+        PartiallyDownloadedBlock partialBlock(&pool);
+        EXPECT_EQ(partialBlock.InitData(CBlockHeaderAndShortTxIDs()), READ_STATUS_INVALID);
+    }
+
+    TEST(TestBlockEncodings, block_transactions_request_round_trip)
+    {
+        BlockTransactionsRequest req;
+        req.blockhash = ArithToUint256(arith_uint256(42));
+        req.indexes = {0, 1, 3, 4, 1000, 65535};
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << req;
+        BlockTransactionsRequest req2;
+        ss >> req2;
+        EXPECT_EQ(req2.blockhash, req.blockhash);
+        EXPECT_EQ(req2.indexes, req.indexes);
+    }
+}
@@ -13,6 +13,7 @@
 #include "undo.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
+#include "txdb.h"
 
 #include <vector>
 #include <map>
@@ -1008,4 +1009,109 @@ TEST(TestCoins, ccoins_serialization)
     }
 }
 
+class CCoinsViewDBTest : public CCoinsViewDB
+{
+public:
+    CCoinsViewDBTest() : CCoinsViewDB(1 << 23, true) {}
+
+    //! Store coins the way versions before per-output records did
+    void WriteLegacyCoins(const uint256 &txid, const CCoins &coins) {
+        db.Write(std::make_pair('c', txid), coins);
+    }
+
+    void WriteChainstateVersion(int nVersion) {
+        db.Write('v', nVersion);
+    }
+};
+
+CCoins MakeCoins(int nOutputs, int nHeight)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    mtx.vout.resize(nOutputs);
+    for (int i = 0; i < nOutputs; i++) {
+        mtx.vout[i].nValue = 1000 * (i + 1);
+        mtx.vout[i].scriptPubKey = CScript() << OP_1;
+    }
+    return CCoins(CTransaction(mtx), nHeight);
+}
+
+TEST(TestCoins, coins_db_output_records)
+{
+    CCoinsViewDBTest db;
+    uint256 txid = GetRandHash();
+    CCoins coins = MakeCoins(4, 100);
+    {
+        CCoinsViewCache cache(&db);
+        *cache.ModifyCoins(txid) = coins;
+        EXPECT_TRUE(cache.Flush());
+    }
+    CCoins read;
+    ASSERT_TRUE(db.GetCoins(txid, read));
+    EXPECT_TRUE(read == coins);
+
+    // Spend outputs through two layers of cache, the last one trims the vout
+    {
+        CCoinsViewCache cache(&db);
+        {
+            CCoinsViewCache child(&cache);
+            EXPECT_TRUE(child.ModifyCoins(txid)->Spend(1));
+            EXPECT_TRUE(child.Flush());
+        }
+        EXPECT_TRUE(cache.ModifyCoins(txid)->Spend(3));
+        EXPECT_TRUE(cache.Flush());
+    }
+    coins.Spend(1);
+    coins.Spend(3);
+    ASSERT_TRUE(db.GetCoins(txid, read));
+    EXPECT_EQ(read.vout.size(), 3);
+    EXPECT_TRUE(read == coins);
+
+    // Spending everything removes the transaction
+    {
+        CCoinsViewCache cache(&db);
+        {
+            CCoinsModifier modifier = cache.ModifyCoins(txid);
+            modifier->Spend(0);
+            modifier->Spend(2);
+        }
+        EXPECT_TRUE(cache.Flush());
+    }
+    EXPECT_FALSE(db.HaveCoins(txid));
+    EXPECT_FALSE(db.GetCoins(txid, read));
+}
+
+TEST(TestCoins, coins_db_upgrade)
+{
+    CCoinsViewDBTest db;
+    std::vector<std::pair<uint256, CCoins>> vLegacy;
+    for (int i = 0; i < 10; i++) {
+        CCoins coins = MakeCoins(1 + i, 10 + i);
+        if (i > 0)
+            coins.Spend(0);
+        vLegacy.push_back(std::make_pair(GetRandHash(), coins));
+        db.WriteLegacyCoins(vLegacy.back().first, coins);
+    }
+
+    ASSERT_TRUE(db.Upgrade());
+    for (const auto& legacy : vLegacy) {
+        CCoins read;
+        ASSERT_TRUE(db.GetCoins(legacy.first, read));
+        EXPECT_TRUE(read == legacy.second);
+    }
+    // Nothing left to upgrade
+    EXPECT_TRUE(db.Upgrade());
+}
+
+TEST(TestCoins, coins_db_rejects_newer_version)
+{
+    CCoinsViewDBTest db;
+    EXPECT_TRUE(db.Upgrade());
+    EXPECT_TRUE(db.Upgrade());
+
+    db.WriteChainstateVersion(2);
+    EXPECT_FALSE(db.Upgrade());
+}
+
 } // namespace TestCoins
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "clientversion.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "util.h"
+#include "util/mappedfile.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace TestMappedFile {
+
+    TEST(TestMappedFile, reads_block_from_mapped_file)
+    {
+        CBlock block;
+        block.nTime = 1600000000;
+        block.nSolution = std::vector<unsigned char>(1344, 0x5a);
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 1000;
+        block.vtx.push_back(CTransaction(mtx));
+        block.hashMerkleRoot = block.BuildMerkleTree();
+
+        // Two blocks back to back, like in a blk file
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << block << block;
+        size_t nBlockSize = ss.size() / 2;
+
+        boost::filesystem::path path = GetTempPath() / boost::filesystem::unique_path("mappedfile-%%%%.dat");
+        {
+            boost::filesystem::ofstream file(path, std::ios::binary);
+            file.write(&ss[0], ss.size());
+        }
+
+        std::shared_ptr<const CMappedFile> mapped = CMappedFile::Open(path);
+#ifdef WIN32
+        EXPECT_FALSE(mapped);
+#else
+        ASSERT_TRUE(mapped);
+        ASSERT_EQ(mapped->size(), ss.size());
+
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, mapped->data() + nBlockSize, mapped->data() + mapped->size());
+        CBlock block2;
+        reader >> block2;
+        EXPECT_TRUE(reader.empty());
+        EXPECT_EQ(block2.GetHash(), block.GetHash());
+        ASSERT_EQ(block2.vtx.size(), 1u);
+        EXPECT_EQ(block2.vtx[0].GetHash(), block.vtx[0].GetHash());
+
+        // Reading past the end of the mapping throws instead of touching unmapped memory
+        EXPECT_THROW(reader >> block2, std::ios_base::failure);
+#endif
+
+        mapped.reset();
+        boost::filesystem::remove(path);
+    }
+
+    TEST(TestMappedFile, missing_file)
+    {
+        EXPECT_FALSE(CMappedFile::Open(GetTempPath() / boost::filesystem::unique_path("mappedfile-%%%%.missing")));
+    }
+}
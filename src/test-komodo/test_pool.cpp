@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "memusage.h"
+#include "support/allocators/pool.h"
+
+#include <boost/unordered_map.hpp>
+
+namespace TestPool {
+
+    typedef PoolAllocator<std::pair<const int, int64_t>, 64, alignof(void*)> Allocator;
+    typedef boost::unordered_map<int, int64_t, boost::hash<int>, std::equal_to<int>, Allocator> PooledMap;
+
+    TEST(TestPool, reuses_freed_blocks)
+    {
+        Allocator::ResourceType resource(4096);
+        void* a = resource.Allocate(24, alignof(void*));
+        void* b = resource.Allocate(24, alignof(void*));
+        EXPECT_NE(a, b);
+        EXPECT_EQ(resource.NumAllocatedChunks(), 1u);
+
+        resource.Deallocate(a, 24, alignof(void*));
+        EXPECT_EQ(resource.Allocate(24, alignof(void*)), a);
+
+        // Too big for the pool, comes from the heap
+        void* c = resource.Allocate(1024, alignof(void*));
+        EXPECT_EQ(resource.NumAllocatedChunks(), 1u);
+        resource.Deallocate(c, 1024, alignof(void*));
+        resource.Deallocate(b, 24, alignof(void*));
+    }
+
+    TEST(TestPool, map_memory_is_held_by_the_pool)
+    {
+        Allocator::ResourceType resource;
+        {
+            PooledMap map(0, boost::hash<int>(), std::equal_to<int>(), &resource);
+            for (int i = 0; i < 10000; i++) {
+                map[i] = i;
+            }
+            for (int i = 0; i < 10000; i += 2) {
+                map.erase(i);
+            }
+            EXPECT_EQ(map.size(), 5000u);
+            EXPECT_EQ(map[9999], 9999);
+            // Erased nodes stay in the pool, so refilling takes no new chunks
+            size_t nChunks = resource.NumAllocatedChunks();
+            for (int i = 0; i < 10000; i += 2) {
+                map[i] = -i;
+            }
+            EXPECT_EQ(resource.NumAllocatedChunks(), nChunks);
+            EXPECT_GE(memusage::DynamicUsage(resource), resource.AllocatedChunkBytes());
+            EXPECT_LT(memusage::DynamicUsage(map), resource.AllocatedChunkBytes());
+        }
+
+        // A map without a pool uses the heap
+        PooledMap heapMap;
+        heapMap[1] = 1;
+        EXPECT_EQ(heapMap.get_allocator().resource(), nullptr);
+        EXPECT_GT(memusage::DynamicUsage(heapMap), 0u);
+    }
+}
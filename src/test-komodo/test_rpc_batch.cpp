@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "net.h"
+#include "rpc/server.h"
+#include "script/script.h"
+#include "util/strencodings.h"
+
+#include <string>
+
+namespace TestRpcBatch {
+
+    static UniValue MakeRequest(const std::string& strMethod, const UniValue& params, int nId)
+    {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("method", strMethod));
+        req.push_back(Pair("params", params));
+        req.push_back(Pair("id", nId));
+        return req;
+    }
+
+    /**
+     * Runs of read-only decodescript calls, split by setban calls that change
+     * the ban list and listbanned calls that read it back.
+     */
+    static UniValue MakeMixedBatch()
+    {
+        UniValue batch(UniValue::VARR);
+        for (int i = 0; i < 60; i++) {
+            UniValue params(UniValue::VARR);
+            if (i % 10 == 7) {
+                params.push_back("10.0.0." + std::to_string(i));
+                params.push_back("add");
+                batch.push_back(MakeRequest("setban", params, i));
+            } else if (i % 10 == 8) {
+                batch.push_back(MakeRequest("listbanned", params, i));
+            } else {
+                CScript script = CScript() << OP_DUP << (int64_t)(1000 + i) << OP_DROP;
+                params.push_back(HexStr(script.begin(), script.end()));
+                batch.push_back(MakeRequest("decodescript", params, i));
+            }
+        }
+        return batch;
+    }
+
+    TEST(TestRpcBatch, mixed_batch_keeps_request_order)
+    {
+        SetRPCWarmupFinished();
+        CNode::ClearBanned();
+        StartRPCBatchThreadPool(4);
+
+        UniValue batch = MakeMixedBatch();
+        UniValue replies;
+        ASSERT_TRUE(replies.read(JSONRPCExecBatch(batch.get_array())));
+
+        StopRPCBatchThreadPool();
+        CNode::ClearBanned();
+
+        ASSERT_TRUE(replies.isArray());
+        ASSERT_EQ(replies.size(), batch.size());
+        for (size_t i = 0; i < replies.size(); i++) {
+            const UniValue& req = batch[i];
+            const std::string& strMethod = find_value(req, "method").get_str();
+            EXPECT_EQ(find_value(replies[i], "id").get_int(), (int)i);
+            EXPECT_TRUE(find_value(replies[i], "error").isNull());
+            if (strMethod == "listbanned") {
+                // Sees every ban added before it in the batch and none after
+                EXPECT_EQ(find_value(replies[i], "result").size(), i / 10 + 1);
+            } else if (strMethod == "decodescript") {
+                UniValue result = tableRPC.execute(strMethod, find_value(req, "params"));
+                EXPECT_EQ(find_value(replies[i], "result").write(), result.write());
+            }
+        }
+    }
+}
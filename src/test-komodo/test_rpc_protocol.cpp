@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "rpc/protocol.h"
+
+#include <string>
+
+namespace TestRpcProtocol {
+
+    static UniValue MakeListing(int n)
+    {
+        UniValue list(UniValue::VARR);
+        for (int i = 0; i < n; i++) {
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("index", i));
+            entry.push_back(Pair("value", 1.5 * i));
+            entry.push_back(Pair("memo", std::string("quote \" slash \\ newline \n ") + std::to_string(i)));
+            entry.push_back(Pair("spent", i % 2 == 0));
+            entry.push_back(Pair("outputs", UniValue(UniValue::VARR)));
+            entry.push_back(Pair("extra", NullUniValue));
+            list.push_back(entry);
+        }
+        return list;
+    }
+
+    TEST(TestRpcProtocol, json_write_chunked_matches_write)
+    {
+        UniValue list = MakeListing(1000);
+        for (size_t nChunkSize : {1, 100, 4096, 1 << 20}) {
+            std::string out;
+            size_t nChunks = 0;
+            JSONWriteChunked(list, [&](const std::string& chunk) {
+                EXPECT_FALSE(chunk.empty());
+                out += chunk;
+                nChunks++;
+            }, nChunkSize);
+            EXPECT_EQ(out, list.write());
+            if (nChunkSize == 4096) {
+                EXPECT_GT(nChunks, 1u);
+            }
+        }
+    }
+
+    TEST(TestRpcProtocol, jsonrpc_reply_chunked_matches_reply)
+    {
+        UniValue list = MakeListing(100);
+        UniValue id("req-1");
+        UniValue error = JSONRPCError(RPC_MISC_ERROR, "failed");
+
+        std::string out;
+        auto append = [&](const std::string& chunk) { out += chunk; };
+
+        JSONRPCReplyChunked(list, NullUniValue, id, append, 256);
+        EXPECT_EQ(out, JSONRPCReply(list, NullUniValue, id));
+
+        out.clear();
+        JSONRPCReplyChunked(list, error, id, append, 256);
+        EXPECT_EQ(out, JSONRPCReply(list, error, id));
+
+        out.clear();
+        JSONRPCReplyChunked(UniValue(42), NullUniValue, NullUniValue, append);
+        EXPECT_EQ(out, JSONRPCReply(UniValue(42), NullUniValue, NullUniValue));
+    }
+}
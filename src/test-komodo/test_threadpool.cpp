@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "threadpool.h"
+
+#include <atomic>
+#include <thread>
+
+namespace TestThreadPool {
+
+    TEST(TestThreadPool, runs_inline_when_stopped)
+    {
+        CThreadPool pool("test");
+        EXPECT_EQ(pool.Size(), 0);
+        auto f = pool.Submit([]() { return std::this_thread::get_id(); });
+        EXPECT_EQ(pool.Wait(f), std::this_thread::get_id());
+    }
+
+    TEST(TestThreadPool, runs_all_tasks)
+    {
+        CThreadPool pool("test");
+        pool.Start(4);
+        EXPECT_EQ(pool.Size(), 4);
+
+        std::atomic<int> nCount(0);
+        std::vector<std::future<int>> vFutures;
+        for (int i = 0; i < 1000; i++) {
+            vFutures.emplace_back(pool.Submit([&nCount, i]() { nCount++; return i; }));
+        }
+        for (int i = 0; i < 1000; i++) {
+            EXPECT_EQ(pool.Wait(vFutures[i]), i);
+        }
+        EXPECT_EQ(nCount, 1000);
+
+        pool.Stop();
+        EXPECT_EQ(pool.Size(), 0);
+    }
+
+    TEST(TestThreadPool, nested_tasks_do_not_deadlock)
+    {
+        CThreadPool pool("test");
+        pool.Start(1);
+
+        // The only worker waits on a task queued behind it
+        auto outer = pool.Submit([&pool]() {
+            auto inner = pool.Submit([]() { return 7; });
+            return pool.Wait(inner) + 1;
+        });
+        EXPECT_EQ(pool.Wait(outer), 8);
+    }
+
+    TEST(TestThreadPool, wait_only_runs_own_tasks)
+    {
+        CThreadPool pool("test");
+        pool.Start(1);
+
+        // Keep the only worker busy so everything else stays queued
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::atomic<bool> fBlocking(false);
+        auto blocker = pool.Submit([&]() { fBlocking = true; released.wait(); });
+        while (!fBlocking) {
+            std::this_thread::yield();
+        }
+
+        // A task from another thread must not run on this one while it waits
+        std::atomic<bool> fOtherRan(false);
+        std::thread::id otherRanOn;
+        std::promise<void> submitted;
+        std::thread other([&]() {
+            auto f = pool.Submit([&]() { otherRanOn = std::this_thread::get_id(); fOtherRan = true; });
+            submitted.set_value();
+            f.get();
+        });
+        submitted.get_future().wait();
+
+        auto own = pool.Submit([]() { return std::this_thread::get_id(); });
+        EXPECT_EQ(pool.Wait(own), std::this_thread::get_id());
+        EXPECT_FALSE(fOtherRan);
+
+        release.set_value();
+        other.join();
+        pool.Wait(blocker);
+        EXPECT_TRUE(fOtherRan);
+        EXPECT_NE(otherRanOn, std::this_thread::get_id());
+    }
+
+    TEST(TestThreadPool, stop_drains_queue)
+    {
+        std::atomic<int> nCount(0);
+        {
+            CThreadPool pool("test");
+            pool.Start(2);
+            for (int i = 0; i < 100; i++) {
+                pool.Submit([&nCount]() { nCount++; });
+            }
+            pool.Stop();
+        }
+        EXPECT_EQ(nCount, 100);
+    }
+
+    TEST(TestThreadPool, partition_by_cost)
+    {
+        EXPECT_TRUE(PartitionByCost({}, 4).empty());
+
+        // Uniform costs split evenly
+        auto vChunks = PartitionByCost(std::vector<uint64_t>(8, 1), 4);
+        ASSERT_EQ(vChunks.size(), 4);
+        for (size_t i = 0; i < vChunks.size(); i++) {
+            EXPECT_EQ(vChunks[i].first, i * 2);
+            EXPECT_EQ(vChunks[i].second, i * 2 + 2);
+        }
+
+        // Never more chunks than items
+        vChunks = PartitionByCost(std::vector<uint64_t>(3, 1), 8);
+        ASSERT_EQ(vChunks.size(), 3);
+
+        // An expensive item gets a chunk of its own
+        vChunks = PartitionByCost({10, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}, 2);
+        ASSERT_EQ(vChunks.size(), 2);
+        EXPECT_EQ(vChunks[0].second, 1);
+        EXPECT_EQ(vChunks[1].first, 1);
+        EXPECT_EQ(vChunks[1].second, 11);
+
+        // Equal cost items without a cost vector
+        EXPECT_TRUE(PartitionEvenly(0, 4).empty());
+        vChunks = PartitionEvenly(10, 4);
+        ASSERT_EQ(vChunks.size(), 4);
+        EXPECT_EQ(vChunks[0].second - vChunks[0].first, 3);
+        EXPECT_EQ(vChunks[1].second - vChunks[1].first, 3);
+        EXPECT_EQ(vChunks[2].second - vChunks[2].first, 2);
+        EXPECT_EQ(vChunks[3].second, 10);
+
+        // Chunks are contiguous and cover every item
+        std::vector<uint64_t> vCost = {5, 3, 8, 1, 1, 9, 2, 2, 4, 7};
+        vChunks = PartitionByCost(vCost, 3);
+        ASSERT_EQ(vChunks.size(), 3);
+        size_t nNext = 0;
+        for (const auto& chunk : vChunks) {
+            EXPECT_EQ(chunk.first, nNext);
+            EXPECT_LT(chunk.first, chunk.second);
+            nNext = chunk.second;
+        }
+        EXPECT_EQ(nNext, vCost.size());
+    }
+
+    TEST(TestThreadPool, parallel_sort)
+    {
+        CThreadPool pool("test");
+        pool.Start(3);
+
+        // Odd sized input so one run is carried over to the next merge round
+        std::vector<std::pair<int, int>> v;
+        for (int i = 0; i < 10007; i++) {
+            v.emplace_back((i * 7919) % 1009, i);
+        }
+        std::vector<std::pair<int, int>> expected = v;
+        std::sort(expected.begin(), expected.end());
+
+        ParallelSort(pool, v.begin(), v.end(), std::less<std::pair<int, int>>());
+        EXPECT_EQ(v, expected);
+
+        // Falls back to a plain sort for tiny inputs and a stopped pool
+        std::vector<int> small = {3, 1, 2};
+        ParallelSort(pool, small.begin(), small.end(), std::less<int>());
+        EXPECT_EQ(small, std::vector<int>({1, 2, 3}));
+        pool.Stop();
+        std::vector<int> stopped = {5, 4, 9, 1};
+        ParallelSort(pool, stopped.begin(), stopped.end(), std::less<int>());
+        EXPECT_EQ(stopped, std::vector<int>({1, 4, 5, 9}));
+    }
+}
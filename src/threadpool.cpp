@@ -0,0 +1,285 @@
+// Copyright (c) 2024 The Pirate developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#include "threadpool.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+namespace {
+/** Pool and queue index of the current thread if it is a pool worker */
+thread_local const CThreadPool* tlsPool = nullptr;
+thread_local size_t tlsQueue = 0;
+/** Task group of the task running on this thread, or of the thread itself outside the pool */
+thread_local uint64_t tlsGroup = 0;
+std::atomic<uint64_t> nNextGroup(0);
+
+uint64_t CurrentGroup()
+{
+    if (tlsGroup == 0) {
+        tlsGroup = ++nNextGroup;
+    }
+    return tlsGroup;
+}
+
+CThreadPool processingPool("pirate-proc");
+}
+
+CThreadPool::CThreadPool(const std::string& name) : strName(name), fRunning(false), nPending(0), nNextQueue(0), nQueued(0)
+{
+}
+
+CThreadPool::~CThreadPool()
+{
+    Stop();
+}
+
+void CThreadPool::Start(int nThreads)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    if (fRunning || nThreads <= 0 || !vThreads.empty()) {
+        return;
+    }
+
+    for (int i = 0; i < nThreads; i++) {
+        vQueues.emplace_back(new WorkerQueue());
+    }
+    fRunning = true;
+    for (int i = 0; i < nThreads; i++) {
+        vThreads.emplace_back(&CThreadPool::ThreadWorker, this, i);
+    }
+}
+
+void CThreadPool::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (!fRunning) {
+            return;
+        }
+        fRunning = false;
+    }
+    cond.notify_all();
+
+    // Workers only exit once every queued task has run
+    for (auto& thread : vThreads) {
+        thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(cs);
+    vThreads.clear();
+    vQueues.clear();
+}
+
+int CThreadPool::Size() const
+{
+    std::unique_lock<std::mutex> lock(cs);
+    return fRunning ? vThreads.size() : 0;
+}
+
+void CThreadPool::Push(Task&& task)
+{
+    QueuedTask queued{CurrentGroup(), std::move(task)};
+    bool fQueued = false;
+    {
+        // Holding cs keeps Stop from clearing the queues under us, and orders
+        // the notify after a worker has checked its wait predicate
+        std::unique_lock<std::mutex> lock(cs);
+        if (fRunning) {
+            size_t nQueue = (tlsPool == this) ? tlsQueue : (nNextQueue++ % vQueues.size());
+            {
+                std::unique_lock<std::mutex> queueLock(vQueues[nQueue]->cs);
+                vQueues[nQueue]->tasks.emplace_back(std::move(queued));
+            }
+            nPending++;
+            nQueued++;
+            fQueued = true;
+        }
+    }
+
+    if (!fQueued) {
+        // Not running, or stopping: run inline so the future is still fulfilled
+        RunTask(queued);
+        return;
+    }
+    cond.notify_one();
+    NotifyWaiters();
+}
+
+bool CThreadPool::PopOrSteal(size_t nQueue, uint64_t nGroup, QueuedTask& task)
+{
+    auto matches = [nGroup](const QueuedTask& queued) { return nGroup == 0 || queued.nGroup == nGroup; };
+
+    // Own queue first, oldest task first
+    {
+        WorkerQueue& queue = *vQueues[nQueue];
+        std::unique_lock<std::mutex> lock(queue.cs);
+        auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(), matches);
+        if (it != queue.tasks.end()) {
+            task = std::move(*it);
+            queue.tasks.erase(it);
+            nPending--;
+            return true;
+        }
+    }
+
+    // Steal the newest task from the other queues
+    for (size_t i = 1; i < vQueues.size(); i++) {
+        WorkerQueue& queue = *vQueues[(nQueue + i) % vQueues.size()];
+        std::unique_lock<std::mutex> lock(queue.cs);
+        auto it = std::find_if(queue.tasks.rbegin(), queue.tasks.rend(), matches);
+        if (it != queue.tasks.rend()) {
+            task = std::move(*it);
+            queue.tasks.erase(std::next(it).base());
+            nPending--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CThreadPool::RunTask(QueuedTask& task)
+{
+    uint64_t nGroupBefore = tlsGroup;
+    tlsGroup = task.nGroup;
+    task.fn();
+    tlsGroup = nGroupBefore;
+    NotifyWaiters();
+}
+
+void CThreadPool::NotifyWaiters()
+{
+    {
+        // Orders the notify after a waiter has checked its predicate
+        std::unique_lock<std::mutex> lock(csWaiters);
+    }
+    condWaiters.notify_all();
+}
+
+bool CThreadPool::RunPendingTask(uint64_t nGroup)
+{
+    QueuedTask task;
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (vQueues.empty() || nPending == 0) {
+            return false;
+        }
+        if (!PopOrSteal(tlsPool == this ? tlsQueue : 0, nGroup, task)) {
+            return false;
+        }
+    }
+    RunTask(task);
+    return true;
+}
+
+void CThreadPool::WaitUntil(const std::function<bool()>& fDone)
+{
+    const uint64_t nGroup = CurrentGroup();
+    while (!fDone()) {
+        uint64_t nQueuedBefore = nQueued;
+        if (RunPendingTask(nGroup)) {
+            continue;
+        }
+
+        // Sleep until a task finishes or a new one is queued
+        std::unique_lock<std::mutex> lock(csWaiters);
+        condWaiters.wait(lock, [&]() { return fDone() || nQueued != nQueuedBefore; });
+    }
+}
+
+void CThreadPool::ThreadWorker(size_t nQueue)
+{
+    RenameThread(strprintf("%s-%d", strName, nQueue).c_str());
+    tlsPool = this;
+    tlsQueue = nQueue;
+
+    while (true) {
+        QueuedTask task;
+        if (PopOrSteal(nQueue, 0, task)) {
+            RunTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(cs);
+        if (!fRunning && nPending == 0) {
+            break;
+        }
+        cond.wait(lock, [this]() { return nPending > 0 || !fRunning; });
+    }
+
+    tlsPool = nullptr;
+}
+
+std::vector<std::pair<size_t, size_t>> PartitionByCost(const std::vector<uint64_t>& vCost, size_t nChunks)
+{
+    std::vector<std::pair<size_t, size_t>> vChunks;
+    if (vCost.empty()) {
+        return vChunks;
+    }
+    nChunks = std::max<size_t>(1, std::min(nChunks, vCost.size()));
+
+    uint64_t nTotal = 0;
+    for (uint64_t nCost : vCost) {
+        nTotal += nCost;
+    }
+
+    // Close a chunk once its running cost reaches its share of what is left
+    size_t nBegin = 0;
+    uint64_t nRemaining = nTotal;
+    for (size_t nChunk = 0; nChunk < nChunks && nBegin < vCost.size(); nChunk++) {
+        size_t nChunksLeft = nChunks - nChunk;
+        uint64_t nTarget = (nRemaining + nChunksLeft - 1) / nChunksLeft;
+        size_t nEnd = nBegin;
+        uint64_t nChunkCost = 0;
+        // Leave at least one item for each remaining chunk
+        while (nEnd < vCost.size() - (nChunksLeft - 1) && (nEnd == nBegin || nChunkCost < nTarget)) {
+            nChunkCost += vCost[nEnd];
+            nEnd++;
+        }
+        if (nChunksLeft == 1) {
+            nEnd = vCost.size();
+        }
+        vChunks.emplace_back(nBegin, nEnd);
+        nRemaining -= std::min(nRemaining, nChunkCost);
+        nBegin = nEnd;
+    }
+
+    return vChunks;
+}
+
+std::vector<std::pair<size_t, size_t>> PartitionEvenly(size_t nItems, size_t nChunks)
+{
+    std::vector<std::pair<size_t, size_t>> vChunks;
+    if (nItems == 0) {
+        return vChunks;
+    }
+    nChunks = std::max<size_t>(1, std::min(nChunks, nItems));
+
+    // The first nItems % nChunks chunks take one extra item
+    size_t nBegin = 0;
+    for (size_t nChunk = 0; nChunk < nChunks; nChunk++) {
+        size_t nEnd = nBegin + nItems / nChunks + (nChunk < nItems % nChunks ? 1 : 0);
+        vChunks.emplace_back(nBegin, nEnd);
+        nBegin = nEnd;
+    }
+
+    return vChunks;
+}
+
+CThreadPool& GetProcessingThreadPool()
+{
+    return processingPool;
+}
+
+void StartProcessingThreadPool(int nThreads)
+{
+    processingPool.Start(nThreads);
+}
+
+void StopProcessingThreadPool()
+{
+    processingPool.Stop();
+}
@@ -0,0 +1,184 @@
+// Copyright (c) 2024 The Pirate developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef PIRATE_THREADPOOL_H
+#define PIRATE_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Long lived work-stealing executor.
+ *
+ * Each worker owns a task deque. Tasks submitted from outside the pool are
+ * spread across the worker deques, tasks submitted from a worker go to its
+ * own deque. An idle worker first drains its own deque from the front and
+ * then steals from the back of the other workers' deques.
+ *
+ * If the pool has not been started, or has been stopped, submitted tasks run
+ * inline on the calling thread, so callers never need a fallback path.
+ *
+ * Usage:
+ *
+ * CThreadPool pool("worker");
+ * pool.Start(4);
+ * auto f = pool.Submit([]() { return DoWork(); });
+ * f.get();
+ * pool.Stop();
+ */
+class CThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit CThreadPool(const std::string& name);
+    ~CThreadPool();
+
+    CThreadPool(const CThreadPool&) = delete;
+    CThreadPool& operator=(const CThreadPool&) = delete;
+
+    /** Start nThreads workers. Does nothing if the pool is already running. */
+    void Start(int nThreads);
+
+    /** Finish all queued tasks and join the workers. */
+    void Stop();
+
+    /** Number of running workers, 0 when tasks run inline. */
+    int Size() const;
+
+    /** Queue a callable and return a future for its result. */
+    template <typename F>
+    std::future<typename std::invoke_result<typename std::decay<F>::type>::type> Submit(F&& f)
+    {
+        typedef typename std::invoke_result<typename std::decay<F>::type>::type R;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        Push([task]() { (*task)(); });
+        return result;
+    }
+
+    /**
+     * Wait for a future of a task submitted to this pool. While waiting, the
+     * caller runs queued tasks of its own task group, so tasks may safely
+     * submit and wait on other tasks. Tasks submitted by other threads are
+     * never run here: a caller may hold locks those tasks don't expect.
+     */
+    template <typename R>
+    R Wait(std::future<R>& future)
+    {
+        WaitUntil([&future]() { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+        return future.get();
+    }
+
+private:
+    /**
+     * A task and the group it belongs to. A thread outside the pool has a group
+     * of its own, tasks it submits join it, and so do the tasks they submit.
+     */
+    struct QueuedTask {
+        uint64_t nGroup;
+        Task fn;
+    };
+
+    struct WorkerQueue {
+        std::mutex cs;
+        std::deque<QueuedTask> tasks;
+    };
+
+    const std::string strName;
+    std::vector<std::unique_ptr<WorkerQueue>> vQueues;
+    std::vector<std::thread> vThreads;
+
+    /** Guards vQueues/vThreads resizing and is used to park idle workers */
+    mutable std::mutex cs;
+    std::condition_variable cond;
+    std::atomic<bool> fRunning;
+    std::atomic<uint64_t> nPending;
+    std::atomic<uint64_t> nNextQueue;
+
+    /** Wakes threads in Wait when a task finishes or is queued */
+    std::mutex csWaiters;
+    std::condition_variable condWaiters;
+    std::atomic<int> nWaiters;
+    std::atomic<uint64_t> nQueued;
+
+    void Push(Task&& task);
+    /** Take a task, from any group if nGroup is 0 */
+    bool PopOrSteal(size_t nQueue, uint64_t nGroup, QueuedTask& task);
+    bool RunPendingTask(uint64_t nGroup);
+    void RunTask(QueuedTask& task);
+    void NotifyWaiters();
+    void WaitUntil(const std::function<bool()>& fDone);
+    void ThreadWorker(size_t nQueue);
+};
+
+/**
+ * Split items into at most nChunks contiguous ranges of roughly equal total cost.
+ * Returns [begin, end) index pairs, empty ranges are never returned.
+ */
+std::vector<std::pair<size_t, size_t>> PartitionByCost(const std::vector<uint64_t>& vCost, size_t nChunks);
+
+/** Split nItems items of equal cost into at most nChunks contiguous ranges. */
+std::vector<std::pair<size_t, size_t>> PartitionEvenly(size_t nItems, size_t nChunks);
+
+/**
+ * Sort [begin, end) on the pool: equal slices are sorted in parallel, then
+ * neighbouring slices are merged pairwise, also in parallel, until one is left.
+ */
+template <typename RandomIt, typename Compare>
+void ParallelSort(CThreadPool& pool, RandomIt begin, RandomIt end, Compare comp)
+{
+    std::vector<std::pair<size_t, size_t>> vRuns = PartitionEvenly(end - begin, std::max(pool.Size(), 1));
+    if (vRuns.size() <= 1) {
+        std::sort(begin, end, comp);
+        return;
+    }
+
+    std::vector<std::future<void>> vFutures;
+    for (const auto& run : vRuns) {
+        vFutures.emplace_back(pool.Submit([=]() { std::sort(begin + run.first, begin + run.second, comp); }));
+    }
+    for (auto& future : vFutures) {
+        pool.Wait(future);
+    }
+
+    while (vRuns.size() > 1) {
+        std::vector<std::pair<size_t, size_t>> vMerged;
+        vFutures.clear();
+        for (size_t i = 0; i + 1 < vRuns.size(); i += 2) {
+            const auto left = vRuns[i];
+            const auto right = vRuns[i + 1];
+            vFutures.emplace_back(pool.Submit([=]() {
+                std::inplace_merge(begin + left.first, begin + right.first, begin + right.second, comp);
+            }));
+            vMerged.emplace_back(left.first, right.second);
+        }
+        if (vRuns.size() % 2 == 1) {
+            vMerged.push_back(vRuns.back());
+        }
+        for (auto& future : vFutures) {
+            pool.Wait(future);
+        }
+        vRuns.swap(vMerged);
+    }
+}
+
+/** Shared pool for validation and wallet processing, sized by -maxprocessingthreads */
+CThreadPool& GetProcessingThreadPool();
+void StartProcessingThreadPool(int nThreads);
+void StopProcessingThreadPool();
+
+#endif // PIRATE_THREADPOOL_H
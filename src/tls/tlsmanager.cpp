@@ -13,6 +13,10 @@
 #include "utiltls.h"
 #include "random.h"
 
+#ifdef USE_POLL
+#include <poll.h>
+#endif
+
 using namespace std;
 namespace tls
 {
@@ -287,14 +291,25 @@ int TLSManager::waitFor(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl,
             break;
         }
 
+        // The socket may be past FD_SETSIZE when poll() lifts the connection cap
+#ifdef USE_POLL
+        struct pollfd pollfd = {};
+        pollfd.fd = hSocket;
+        pollfd.events = (sslErr == SSL_ERROR_WANT_READ) ? POLLIN : POLLOUT;
+#else
         fd_set socketSet;
         FD_ZERO(&socketSet);
         FD_SET(hSocket, &socketSet);
 
         struct timeval timeout = {timeoutSec, 0};
+#endif
 
         if (sslErr == SSL_ERROR_WANT_READ) {
+#ifdef USE_POLL
+            int result = poll(&pollfd, 1, timeoutSec * 1000);
+#else
             int result = select(hSocket + 1, &socketSet, NULL, NULL, &timeout);
+#endif
             if (result == 0) {
                 LogPrint("tls", "TLS: ERROR: %s: %s():%d - WANT_READ timeout on %s\n", __FILE__, __func__, __LINE__,
                     (eRoutine == SSL_CONNECT ? "SSL_CONNECT" :
@@ -309,7 +324,11 @@ int TLSManager::waitFor(SSLConnectionRoutine eRoutine, SOCKET hSocket, SSL* ssl,
                 break;
             }
         } else {
+#ifdef USE_POLL
+            int result = poll(&pollfd, 1, timeoutSec * 1000);
+#else
             int result = select(hSocket + 1, NULL, &socketSet, NULL, &timeout);
+#endif
             if (result == 0) {
                 LogPrint("tls", "TLS: ERROR: %s: %s():%d - WANT_WRITE timeout on %s\n", __FILE__, __func__, __LINE__,
                     (eRoutine == SSL_CONNECT ? "SSL_CONNECT" :
@@ -631,27 +650,21 @@ void TLSManager::cleanNonTLSPool(std::vector<NODE_ADDR>& vPool, CCriticalSection
  * @brief Handles send and recieve functionality in TLS Sockets.
  *
  * @param pnode reference to the CNode object.
- * @param fdsetRecv
- * @param fdsetSend
- * @param fdsetError
+ * @param recvSet the socket is ready for reading
+ * @param sendSet the socket is ready for writing
+ * @param errorSet the socket has an error or was hung up
  * @return int returns -1 when socket is invalid. returns 0 otherwise.
  */
-int TLSManager::threadSocketHandler(CNode* pnode, fd_set& fdsetRecv, fd_set& fdsetSend, fd_set& fdsetError)
+int TLSManager::threadSocketHandler(CNode* pnode, bool recvSet, bool sendSet, bool errorSet)
 {
     //
     // Receive
     //
-    bool recvSet = false, sendSet = false, errorSet = false;
-
     {
         LOCK(pnode->cs_hSocket);
 
         if (pnode->hSocket == INVALID_SOCKET)
             return -1;
-
-        recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-        sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-        errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
     }
 
     if (recvSet || errorSet) {
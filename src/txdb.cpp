@@ -28,6 +28,7 @@
 #include "uint256.h"
 #include "core_io.h"
 #include "komodo_bitcoind.h"
+#include "threadpool.h"
 
 #include "ui_interface.h"
 #include "init.h"
@@ -45,7 +46,9 @@ static const char DB_SAPLING_ANCHOR = 'Z';
 static const char DB_SAPLING_FRONTIER_ANCHOR = 'Y';
 static const char DB_NULLIFIER = 's';
 static const char DB_SAPLING_NULLIFIER = 'S';
-static const char DB_COINS = 'c';
+static const char DB_COINS = 'c'; // Legacy per-transaction records, see CCoinsViewDB::Upgrade
+static const char DB_COIN = 'C';
+static const char DB_COINS_HEADER = 'T';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'd';
@@ -68,6 +71,123 @@ static const char OUTPUT_PROOF_HASH = 'E';
 
 static const char DB_VERSION = 'V';
 
+//! Chainstate format, 1 is a header per transaction plus one record per unspent output
+static const char DB_CHAINSTATE_VERSION = 'v';
+static const int CHAINSTATE_VERSION = 1;
+
+namespace {
+
+/** Key of an unspent output in the coin database */
+struct CoinKey
+{
+    char prefix;
+    uint256 txid;
+    uint32_t n;
+
+    CoinKey() : prefix(0), n(0) {}
+    CoinKey(const uint256& txidIn, uint32_t nIn) : prefix(DB_COIN), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(prefix);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * The metadata of a transaction with unspent outputs, and which of them are
+ * unspent. Lookups read it first, so a miss costs a single point read.
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nHeight * 2 + fCoinBase)
+ * - the availability bitmask, bit n set if output n is unspent
+ */
+struct CoinsHeader
+{
+    int nVersion;
+    int nHeight;
+    bool fCoinBase;
+    std::vector<unsigned char> vAvail;
+
+    CoinsHeader() : nVersion(0), nHeight(0), fCoinBase(false) {}
+    CoinsHeader(const CCoins& coins) : nVersion(coins.nVersion), nHeight(coins.nHeight), fCoinBase(coins.fCoinBase) {
+        for (uint32_t n = 0; n < coins.vout.size(); n++) {
+            if (coins.IsAvailable(n)) {
+                vAvail.resize(n / 8 + 1);
+                vAvail[n / 8] |= 1 << (n % 8);
+            }
+        }
+    }
+
+    bool IsAvailable(uint32_t n) const {
+        return n / 8 < vAvail.size() && (vAvail[n / 8] & (1 << (n % 8)));
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        unsigned int nCode = nHeight * 2 + (fCoinBase ? 1 : 0);
+        ::Serialize(s, VARINT(nVersion));
+        ::Serialize(s, VARINT(nCode));
+        ::Serialize(s, vAvail);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        unsigned int nCode = 0;
+        ::Unserialize(s, VARINT(nVersion));
+        ::Unserialize(s, VARINT(nCode));
+        nHeight = nCode / 2;
+        fCoinBase = nCode & 1;
+        ::Unserialize(s, vAvail);
+    }
+};
+
+/** An unspent output, serialized via CTxOutCompressor */
+struct CoinValue
+{
+    CTxOut out;
+
+    CoinValue() {}
+    CoinValue(const CTxOut& outIn) : out(outIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        ::Serialize(s, CTxOutCompressor(REF(out)));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        ::Unserialize(s, REF(CTxOutCompressor(out)));
+    }
+};
+
+/** Write or erase the record of one output, depending on whether it is available */
+void BatchWriteCoin(CDBBatch& batch, const uint256& txid, const CCoins& coins, uint32_t n)
+{
+    if (coins.IsAvailable(n))
+        batch.Write(CoinKey(txid, n), CoinValue(coins.vout[n]));
+    else
+        batch.Erase(CoinKey(txid, n));
+}
+
+/** Write the header and every unspent output of a transaction not yet in the database */
+void BatchWriteNewCoins(CDBBatch& batch, const uint256& txid, const CCoins& coins)
+{
+    if (coins.IsPruned())
+        return;
+    batch.Write(std::make_pair(DB_COINS_HEADER, txid), CoinsHeader(coins));
+    for (uint32_t n = 0; n < coins.vout.size(); n++) {
+        if (coins.IsAvailable(n))
+            batch.Write(CoinKey(txid, n), CoinValue(coins.vout[n]));
+    }
+}
+
+} // anon namespace
+
 CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe) {
 }
 
@@ -145,11 +265,29 @@ bool CCoinsViewDB::GetZkProofHash(const uint256 &zkProofHash, ProofType type, st
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    CoinsHeader header;
+    if (!db.Read(make_pair(DB_COINS_HEADER, txid), header))
+        return false;
+
+    coins.Clear();
+    coins.fCoinBase = header.fCoinBase;
+    coins.nHeight = header.nHeight;
+    coins.nVersion = header.nVersion;
+    coins.vout.resize(header.vAvail.size() * 8);
+    for (uint32_t n = 0; n < coins.vout.size(); n++) {
+        if (!header.IsAvailable(n))
+            continue;
+        CoinValue value;
+        if (!db.Read(CoinKey(txid, n), value))
+            return error("%s: unable to read output %s:%u", __func__, txid.ToString(), n);
+        coins.vout[n] = value.out;
+    }
+    coins.Cleanup();
+    return true;
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    return db.Exists(make_pair(DB_COINS_HEADER, txid));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -249,10 +387,19 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins,
     size_t changed = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            const CCoins &coins = it->second.coins;
+            if (it->second.flags & CCoinsCacheEntry::FRESH) {
+                // None of the outputs are in the database yet
+                BatchWriteNewCoins(batch, it->first, coins);
+            } else {
+                // Only rewrite the outputs that were spent or restored
+                for (uint32_t n : it->second.changed)
+                    BatchWriteCoin(batch, it->first, coins, n);
+                if (coins.IsPruned())
+                    batch.Erase(make_pair(DB_COINS_HEADER, it->first));
+                else
+                    batch.Write(make_pair(DB_COINS_HEADER, it->first), CoinsHeader(coins));
+            }
             changed++;
         }
         count++;
@@ -330,30 +477,33 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->Seek(DB_COINS);
+    pcursor->Seek(DB_COIN);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
+    uint256 prevTxid;
+    bool fFirst = true;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+        CoinKey key;
+        CoinValue value;
+        if (pcursor->GetKey(key) && key.prefix == DB_COIN) {
+            if (pcursor->GetValue(value)) {
+                // Hash the outputs grouped by transaction, as the per-transaction records were
+                if (fFirst || key.txid != prevTxid) {
+                    if (!fFirst)
+                        ss << VARINT(0);
+                    stats.nTransactions++;
+                    prevTxid = key.txid;
+                    fFirst = false;
                 }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
+                stats.nTransactionOutputs++;
+                ss << VARINT(key.n+1);
+                ss << value.out;
+                nTotalAmount += value.out.nValue;
+                stats.nSerializedSize += pcursor->GetKeySize() + pcursor->GetValueSize();
             } else {
                 return error("CCoinsViewDB::GetStats() : unable to read value");
             }
@@ -362,6 +512,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
         }
         pcursor->Next();
     }
+    if (!fFirst)
+        ss << VARINT(0);
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
@@ -371,6 +523,66 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     return true;
 }
 
+bool CCoinsViewDB::Upgrade() {
+    int nVersion = 0;
+    if (db.Exists(DB_CHAINSTATE_VERSION) && !db.Read(DB_CHAINSTATE_VERSION, nVersion))
+        return error("%s: unable to read the chainstate version", __func__);
+    if (nVersion > CHAINSTATE_VERSION)
+        return error("%s: chainstate version %d was written by a newer release, this one only reads up to %d. Run with -reindex to downgrade.",
+                     __func__, nVersion, CHAINSTATE_VERSION);
+    if (nVersion == CHAINSTATE_VERSION)
+        return true;
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    std::pair<char, uint256> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS) {
+        // Nothing to convert, a new or already converted database
+        return db.Write(DB_CHAINSTATE_VERSION, CHAINSTATE_VERSION);
+    }
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Upgrading chainstate database to per-output records...\n");
+    uiInterface.ShowProgress(_("Upgrading chainstate database..."), 0, false);
+    size_t nTransactions = 0, nOutputs = 0;
+    bool fDone = false;
+    while (!fDone) {
+        // Convert in batches, each batch erases the records it converted,
+        // so an interrupted upgrade resumes where it stopped.
+        CDBBatch batch(db);
+        for (size_t nBatch = 0; nBatch < 100000; nBatch++) {
+            boost::this_thread::interruption_point();
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS) {
+                fDone = true;
+                break;
+            }
+            CCoins coins;
+            if (!pcursor->GetValue(coins))
+                return error("%s: unable to read coins of %s", __func__, key.second.ToString());
+            BatchWriteNewCoins(batch, key.second, coins);
+            for (uint32_t n = 0; n < coins.vout.size(); n++) {
+                if (coins.IsAvailable(n))
+                    nOutputs++;
+            }
+            batch.Erase(key);
+            nTransactions++;
+            pcursor->Next();
+        }
+        if (fDone)
+            batch.Write(DB_CHAINSTATE_VERSION, CHAINSTATE_VERSION);
+        if (!db.WriteBatch(batch))
+            return error("%s: unable to write upgraded records", __func__);
+        // The txid is uniformly distributed, so its first byte tells how far along we are
+        if (!fDone)
+            uiInterface.ShowProgress(_("Upgrading chainstate database..."), (int)(*key.second.begin()) * 100 / 256, false);
+        if (ShutdownRequested())
+            return false;
+    }
+    uiInterface.ShowProgress("", 100, false);
+    LogPrintf("Upgraded %u transactions to %u output records in %dms\n", nTransactions, nOutputs, GetTimeMillis() - nStart);
+    return true;
+}
+
 /***
  * Write a batch of records and sync
  * @param fileInfo the records to write
@@ -793,95 +1005,116 @@ bool CBlockTreeDB::blockOnchainActive(const uint256 &hash) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+/** Number of entries a loader task reads before adding them to mapBlockIndex */
+static const size_t BLOCK_INDEX_LOAD_BATCH = 4096;
+
+/** Copy a block index entry read from disk into mapBlockIndex. */
+static void LoadBlockIndexEntry(const uint256& hash, const CDiskBlockIndex& diskindex)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    // Construct block index object
+    CBlockIndex* pindexNew            = InsertBlockIndex(hash);
+    pindexNew->pprev                  = InsertBlockIndex(diskindex.hashPrev);
+    pindexNew->nHeight                = diskindex.nHeight;
+    pindexNew->nFile                  = diskindex.nFile;
+    pindexNew->nDataPos               = diskindex.nDataPos;
+    pindexNew->nUndoPos               = diskindex.nUndoPos;
+    pindexNew->hashSproutAnchor       = diskindex.hashSproutAnchor;
+    pindexNew->nVersion               = diskindex.nVersion;
+    pindexNew->hashMerkleRoot         = diskindex.hashMerkleRoot;
+    pindexNew->hashFinalSaplingRoot   = diskindex.hashFinalSaplingRoot;
+    pindexNew->nTime                  = diskindex.nTime;
+    pindexNew->nBits                  = diskindex.nBits;
+    pindexNew->nNonce                 = diskindex.nNonce;
+    // the Equihash solution will be loaded lazily from the dbindex entry
+    pindexNew->nStatus                = diskindex.nStatus;
+    pindexNew->nCachedBranchId        = diskindex.nCachedBranchId;
+    pindexNew->nTx                    = diskindex.nTx;
+    pindexNew->nChainSupplyDelta      = diskindex.nChainSupplyDelta;
+    pindexNew->nTransparentValue      = diskindex.nTransparentValue;
+    pindexNew->nBurnedAmountDelta     = diskindex.nBurnedAmountDelta;
+    pindexNew->nSproutValue           = diskindex.nSproutValue;
+    pindexNew->nSaplingValue          = diskindex.nSaplingValue;
+    pindexNew->segid                  = diskindex.segid;
+    pindexNew->nNotaryPay             = diskindex.nNotaryPay;
+    // POW will be checked before any block is connected
+}
 
-    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
-    int64_t count = 0; int reportDone = 0;
-    uiInterface.ShowProgress(_("Loading guts..."), 0, false);
+/**
+ * Load the block index entries whose hash starts with a byte in [nBegin, nEnd).
+ * Entries are read and deserialized without any lock held and added to
+ * mapBlockIndex in batches under cs_load.
+ */
+static bool LoadBlockIndexShard(CDBWrapper& db, unsigned int nBegin, unsigned int nEnd, std::mutex& cs_load)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
+    uint256 hashBegin;
+    *hashBegin.begin() = nBegin;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, hashBegin));
+
+    std::vector<std::pair<uint256, CDiskBlockIndex>> vBatch;
+    vBatch.reserve(BLOCK_INDEX_LOAD_BATCH);
+    bool fDone = false;
+    while (!fDone) {
         if (ShutdownRequested()) return false;
 
         std::pair<char, uint256> key;
-
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-
-            if (count++ % 256 == 0) {
-                uint32_t high = 0x100 * *key.second.begin() + *(key.second.begin() + 1);
-                int percentageDone = (int)(high * 100.0 / 65536.0 + 0.5);
-                uiInterface.ShowProgress(_("Loading guts..."), percentageDone, false);
-                if (reportDone < percentageDone/10) {
-                    // report max. every 10% step
-                    LogPrintf("[%d%%]...", percentageDone); /* Continued */
-                    reportDone = percentageDone/10;
-                }
-            }
-
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew            = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev                  = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight                = diskindex.nHeight;
-                pindexNew->nFile                  = diskindex.nFile;
-                pindexNew->nDataPos               = diskindex.nDataPos;
-                pindexNew->nUndoPos               = diskindex.nUndoPos;
-                pindexNew->hashSproutAnchor       = diskindex.hashSproutAnchor;
-                pindexNew->nVersion               = diskindex.nVersion;
-                pindexNew->hashMerkleRoot         = diskindex.hashMerkleRoot;
-                pindexNew->hashFinalSaplingRoot   = diskindex.hashFinalSaplingRoot;
-                pindexNew->nTime                  = diskindex.nTime;
-                pindexNew->nBits                  = diskindex.nBits;
-                pindexNew->nNonce                 = diskindex.nNonce;
-                // the Equihash solution will be loaded lazily from the dbindex entry
-                pindexNew->nStatus                = diskindex.nStatus;
-                pindexNew->nCachedBranchId        = diskindex.nCachedBranchId;
-                pindexNew->nTx                    = diskindex.nTx;
-                pindexNew->nChainSupplyDelta      = diskindex.nChainSupplyDelta;
-                pindexNew->nTransparentValue      = diskindex.nTransparentValue;
-                pindexNew->nBurnedAmountDelta     = diskindex.nBurnedAmountDelta;
-                pindexNew->nSproutValue           = diskindex.nSproutValue;
-                pindexNew->nSaplingValue          = diskindex.nSaplingValue;
-                pindexNew->segid                  = diskindex.segid;
-                pindexNew->nNotaryPay             = diskindex.nNotaryPay;
-
-                if ( 0 ) // POW will be checked before any block is connected
-                {
-                    // Consistency checks
-                    CBlockHeader header;
-                    {
-                        LOCK(cs_main);
-                        try {
-                            header = pindexNew->GetBlockHeader();
-                        } catch (const runtime_error&) {
-                            return error("LoadBlockIndex(): failed to read index entry: diskindex hash = %s",
-                                diskindex.GetBlockHash().ToString());
-                        }
-                    }
-                    if (header.GetHash() != pindexNew->GetBlockHash())
-                        return error("LoadBlockIndex(): block header inconsistency detected: on-disk = %s, in-memory = %s",
-                                    diskindex.ToString(),  pindexNew->ToString());
-
-                    uint8_t pubkey33[33];
-                    komodo_index2pubkey33(pubkey33,pindexNew,pindexNew->nHeight);
-                    if (!CheckProofOfWork(header,pubkey33,pindexNew->nHeight,Params().GetConsensus()))
-                        return error("LoadBlockIndex(): CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
-                pcursor->Next();
-            } else {
+        if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX && *key.second.begin() < nEnd) {
+            // The Equihash solution is loaded lazily, so skip it here and take the block hash
+            // from the key rather than hashing the full header of every entry
+            vBatch.emplace_back(key.second, CDiskBlockIndex(false));
+            if (!pcursor->GetValue(vBatch.back().second)) {
                 return error("LoadBlockIndex() : failed to read value");
             }
+            pcursor->Next();
         } else {
-            break;
+            fDone = true;
+        }
+
+        if (vBatch.size() == BLOCK_INDEX_LOAD_BATCH || (fDone && !vBatch.empty())) {
+            std::unique_lock<std::mutex> lock(cs_load);
+            for (const auto& entry : vBatch) {
+                LoadBlockIndexEntry(entry.first, entry.second);
+            }
+            vBatch.clear();
+        }
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts()
+{
+    uiInterface.ShowProgress(_("Loading guts..."), 0, false);
+
+    // Block index keys are ordered by hash, so the key space is split on the
+    // first byte of the hash and the shards are read in parallel. mapBlockIndex
+    // is only touched under cs_load while the caller holds cs_main.
+    CThreadPool& pool = GetProcessingThreadPool();
+    std::vector<std::pair<size_t, size_t>> vShards = PartitionEvenly(256, 4 * std::max(pool.Size(), 1));
+    std::mutex cs_load;
+    std::vector<std::future<bool>> vFutures;
+    for (const auto& shard : vShards) {
+        vFutures.emplace_back(pool.Submit([this, shard, &cs_load]() {
+            return LoadBlockIndexShard(*this, shard.first, shard.second, cs_load);
+        }));
+    }
+
+    bool fSuccess = true;
+    int reportDone = 0;
+    for (size_t i = 0; i < vFutures.size(); i++) {
+        fSuccess &= pool.Wait(vFutures[i]);
+        int percentageDone = (int)((i + 1) * 100.0 / vFutures.size() + 0.5);
+        uiInterface.ShowProgress(_("Loading guts..."), percentageDone, false);
+        if (reportDone < percentageDone/10) {
+            // report max. every 10% step
+            LogPrintf("[%d%%]...", percentageDone); /* Continued */
+            reportDone = percentageDone/10;
         }
     }
 
     uiInterface.ShowProgress("", 100, false);
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
 
-    return true;
+    return fSuccess;
 }
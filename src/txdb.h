@@ -98,6 +98,14 @@ public:
                     CProofHashMap &mapZkOutputProofHash,
                     CProofHashMap &mapZkSpendProofHash);
     bool GetStats(CCoinsStats &stats) const;
+    /**
+     * Convert the per-transaction records of older versions to a header per
+     * transaction plus one record per unspent output, and record the
+     * chainstate version once done.
+     * @returns false on error, if the database was written by a newer
+     * version, or if shutdown was requested before the upgrade finished
+     */
+    bool Upgrade();
 };
 
 /**
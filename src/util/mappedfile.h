@@ -0,0 +1,38 @@
+// Copyright (c) 2024 The Pirate developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php .
+
+#ifndef PIRATE_UTIL_MAPPEDFILE_H
+#define PIRATE_UTIL_MAPPEDFILE_H
+
+#include <fs.h>
+
+#include <cstddef>
+#include <memory>
+
+/**
+ * Read-only memory mapping of a whole file. The file must not be truncated
+ * or rewritten while it is mapped, reading a page past its end raises SIGBUS.
+ */
+class CMappedFile
+{
+public:
+    /** Map a file, returns null if it can't be mapped or memory mapping is not supported on this platform */
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const unsigned char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+
+private:
+    const unsigned char* pdata;
+    size_t nSize;
+
+    CMappedFile(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+};
+
+#endif // PIRATE_UTIL_MAPPEDFILE_H
@@ -960,12 +960,98 @@ void getRpcArcTxJSONReceives(RpcArcTransaction &arcTx, UniValue& ArcTxJSON, bool
     }
 }
 
+typedef std::map<std::pair<int,int>, uint256> TxPositionMap;
+
+/**
+ * Positions of the wallet transactions, keyed like CWallet::mapArcTxsByPosition.
+ * Unconfirmed transactions, and those with an unknown block, are placed after the tip.
+ */
+void getWalletTxPositions(TxPositionMap &positions) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pwalletMain->cs_wallet);
+
+    int nPosUnconfirmed = 0;
+    int nNextHeight = chainActive.Tip()->nHeight + 1;
+    for (map<uint256,CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        const CWalletTx& wtx = (*it).second;
+
+        BlockMap::const_iterator mi = mapBlockIndex.end();
+        if (wtx.GetDepthInMainChain() != 0 && !wtx.hashBlock.IsNull())
+            mi = mapBlockIndex.find(wtx.hashBlock);
+
+        if (mi != mapBlockIndex.end() && mi->second != nullptr) {
+            positions[make_pair(mi->second->nHeight, wtx.nIndex)] = (*it).first;
+        } else {
+            positions[make_pair(nNextHeight, nPosUnconfirmed)] = (*it).first;
+            nPosUnconfirmed++;
+        }
+    }
+}
+
+/**
+ * Walks the wallet and archived transactions from newest to oldest. The
+ * archive is an ordered index, so a page only touches the transactions it
+ * returns rather than every transaction the wallet has seen.
+ */
+class TxPositionCursor
+{
+public:
+    TxPositionCursor(const TxPositionMap &walletIn, const TxPositionMap &archiveIn)
+        : wallet(walletIn), archive(archiveIn), wit(walletIn.rbegin()), ait(archiveIn.rbegin()) {}
+
+    //! Continue from the transaction after txid, returns false if the wallet doesn't know txid
+    bool StartAfter(const uint256 &txid) {
+        std::pair<int,int> position;
+        bool fFound = false;
+        for (TxPositionMap::const_iterator it = wallet.begin(); it != wallet.end(); ++it) {
+            if (it->second == txid) {
+                position = it->first;
+                fFound = true;
+                break;
+            }
+        }
+        if (!fFound && !pwalletMain->GetArcTxPosition(txid, position))
+            return false;
+
+        wit = TxPositionMap::const_reverse_iterator(wallet.lower_bound(position));
+        ait = TxPositionMap::const_reverse_iterator(archive.lower_bound(position));
+        return true;
+    }
+
+    bool Next(std::pair<int,int> &position, uint256 &txid) {
+        bool fWallet = wit != wallet.rend();
+        bool fArchive = ait != archive.rend();
+        if (!fWallet && !fArchive)
+            return false;
+
+        if (fWallet && (!fArchive || wit->first >= ait->first)) {
+            //Confirmed wallet transactions are archived too, visit them once
+            if (fArchive && ait->first == wit->first)
+                ++ait;
+            position = wit->first;
+            txid = wit->second;
+            ++wit;
+        } else {
+            position = ait->first;
+            txid = ait->second;
+            ++ait;
+        }
+        return true;
+    }
+
+private:
+    const TxPositionMap &wallet;
+    const TxPositionMap &archive;
+    TxPositionMap::const_reverse_iterator wit;
+    TxPositionMap::const_reverse_iterator ait;
+};
+
 UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
   if (!EnsureWalletIsAvailable(fHelp))
       return NullUniValue;
 
-  if (fHelp || params.size() > 5 || params.size() == 2)
+  if (fHelp || params.size() > 6 || params.size() == 2)
       throw runtime_error(
         "zs_listtransactions\n"
         "\nReturns an array of decrypted Pirate transactions.\n"
@@ -992,12 +1078,17 @@ UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey&
         "\n"
         "5. \"Include Watch Only\"   (bool, optional, Default = false) \n"
         "\n"
+        "6. \"Start After:\"           (string, optional, default=\"\") \n"
+        "                               Transaction id to page from, only transactions older than it are returned.\n"
+        "                               Pass the txid of the first (oldest) transaction of the previous call to get the next page.\n"
+        "\n"
         "Default Parameters:\n"
         "1. 0 - O confimations required\n"
         "2. 0 - Returns all transactions\n"
         "3. 0 - Ignored\n"
         "4. 100000 - Return the last 100,000 transactions.\n"
         "5. false - exclude watch only\n"
+        "6. \"\" - Start from the newest transaction\n"
         "\n"
         "\nResult:\n"
         "[{\n                                     An Array of Transactions\n"
@@ -1055,6 +1146,7 @@ UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey&
         + HelpExampleCli("zs_listtransactions", "")
         + HelpExampleCli("zs_listtransactions", "1")
         + HelpExampleCli("zs_listtransactions", "1 1 30 200")
+        + HelpExampleCli("zs_listtransactions", "1 0 0 200 false \"txid\"")
         + HelpExampleRpc("zs_listtransactions", "")
         + HelpExampleRpc("zs_listtransactions", "1")
         + HelpExampleRpc("zs_listtransactions", "1 1 30 200")
@@ -1080,15 +1172,20 @@ UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey&
       nFilter = params[2].get_int64();
     }
 
-    if (params.size() == 4) {
+    if (params.size() >= 4) {
       nCount = params[3].get_int64();
     }
 
     bool fIncludeWatchonly = false;
-    if (params.size() == 5) {
+    if (params.size() >= 5) {
         fIncludeWatchonly = params[4].get_bool();
     }
 
+    uint256 startAfter;
+    if (params.size() == 6 && !params[5].get_str().empty()) {
+        startAfter = ParseHashV(params[5], "Start After");
+    }
+
     if (nMinConfirms < 0)
       throw runtime_error("Minimum confimations must be greater that 0");
 
@@ -1098,52 +1195,26 @@ UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey&
     if (nFilter < 0)
         throw runtime_error("Filter must be equal or greater than 0.");
 
-    //get Sorted Archived Transactions
-    std::map<std::pair<int,int>, uint256> sortedArchive;
-    for (map<uint256, ArchiveTxPoint>::iterator it = pwalletMain->mapArcTxs.begin(); it != pwalletMain->mapArcTxs.end(); ++it)
-    {
-      uint256 txid = (*it).first;
-      ArchiveTxPoint arcTxPt = (*it).second;
-      std::pair<int,int> key;
-
-      if (!arcTxPt.hashBlock.IsNull() && mapBlockIndex.count(arcTxPt.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[arcTxPt.hashBlock]->nHeight, arcTxPt.nIndex);
-        sortedArchive[key] = txid;
-      }
-    }
-
-    //add any missing wallet transactions - unconfimred & conflicted
-    int nPosUnconfirmed = 0;
-    for (map<uint256,CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
-      CWalletTx wtx = (*it).second;
-      std::pair<int,int> key;
-
-      if (wtx.GetDepthInMainChain() == 0) {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      } else if (!wtx.hashBlock.IsNull() && mapBlockIndex.count(wtx.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[wtx.hashBlock]->nHeight, wtx.nIndex);
-        sortedArchive[key] = wtx.GetHash();
-      } else {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      }
-
-    }
+    //Wallet transactions, including unconfimred & conflicted
+    TxPositionMap walletPositions;
+    getWalletTxPositions(walletPositions);
 
     uint64_t t = GetTime();
     int chainHeight = chainActive.Tip()->nHeight;
-    //Reverse Iterate thru transactions
-    for (map<std::pair<int,int>, uint256>::reverse_iterator it = sortedArchive.rbegin(); it != sortedArchive.rend(); ++it)
+    //Iterate thru transactions from newest to oldest, starting after the paging cursor
+    TxPositionCursor cursor(walletPositions, pwalletMain->mapArcTxsByPosition);
+    if (!startAfter.IsNull() && !cursor.StartAfter(startAfter))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start after transaction id not found in the wallet");
+
+    std::pair<int,int> position;
+    uint256 txid;
+    while (cursor.Next(position, txid))
     {
-        uint256 txid = (*it).second;
         RpcArcTransaction arcTx;
 
-        //Exclude transactions with block height lower the type 3 filter minimum
-        if (nFilterType == 3 && (*it).first.first < nFilter)
-            continue;
+        //Exclude transactions with block height lower the type 3 filter minimum, all the rest are older
+        if (nFilterType == 3 && position.first < nFilter)
+            break;
 
         if (pwalletMain->mapWallet.count(txid)) {
 
@@ -1177,7 +1248,7 @@ UniValue zs_listtransactions(const UniValue& params, bool fHelp, const CPubKey&
 
         } else {
 
-            int confirms = chainHeight - (*it).first.first + 1;
+            int confirms = chainHeight - position.first + 1;
 
             //Excude transactions with less confirmations than required
             if (confirms < nMinConfirms)
@@ -1344,7 +1415,7 @@ UniValue zs_listspentbyaddress(const UniValue& params, bool fHelp, const CPubKey
   if (!EnsureWalletIsAvailable(fHelp))
       return NullUniValue;
 
-  if (fHelp || params.size() > 5 || params.size() == 3 || params.size() < 1)
+  if (fHelp || params.size() > 6 || params.size() == 3 || params.size() < 1)
       throw runtime_error(
         "zs_listspentbyaddress\n"
         "\nReturns decrypted Pirate spent inputs for a single address.\n"
@@ -1371,12 +1442,17 @@ UniValue zs_listspentbyaddress(const UniValue& params, bool fHelp, const CPubKey
         "5. \"Count:\"                 (numeric, optional, default=100000) \n"
         "                               Last n number of transactions returned\n"
         "\n"
+        "6. \"Start After:\"           (string, optional, default=\"\") \n"
+        "                               Transaction id to page from, only transactions older than it are returned.\n"
+        "                               Pass the txid of the first (oldest) transaction of the previous call to get the next page.\n"
+        "\n"
         "Default Parameters:\n"
         "1. Pirate Address\n"
         "2. 0 - O confimations required\n"
         "3. 0 - Returns all transactions\n"
         "4. 0 - Ignored\n"
         "5. 100000 - Return the last 9,999,999 transactions.\n"
+        "6. \"\" - Start from the newest transaction\n"
         "\n"
         "\nResult:\n"
         "   \"txid\":  \"transactionid\",           (string)  The transaction id.\n"
@@ -1426,10 +1502,15 @@ UniValue zs_listspentbyaddress(const UniValue& params, bool fHelp, const CPubKey
       nFilter = params[3].get_int64();
     }
 
-    if (params.size() == 5) {
+    if (params.size() >= 5) {
       nCount = params[4].get_int64();
     }
 
+    uint256 startAfter;
+    if (params.size() == 6 && !params[5].get_str().empty()) {
+        startAfter = ParseHashV(params[5], "Start After");
+    }
+
     bool fIncludeWatchonly = true;
 
     if (nMinConfirms < 0)
@@ -1469,67 +1550,37 @@ UniValue zs_listspentbyaddress(const UniValue& params, bool fHelp, const CPubKey
     if (!isTAddress && !isZcAddress && !isZsAddress)
         return ret;
 
-    //Get set of txids that the encoded address was used in
-    std::map<std::string, std::set<uint256>>::iterator ait;
-    ait = pwalletMain->mapAddressTxids.find(encodedAddress);
-    std::set<uint256> txids;
-
+    //Archived transactions the encoded address was used in, found through the address index
+    TxPositionMap addressArchive;
+    std::map<std::string, std::set<uint256>>::iterator ait = pwalletMain->mapAddressTxids.find(encodedAddress);
     if (ait != pwalletMain->mapAddressTxids.end()) {
-        txids = ait->second;
-    }
-
-    //get Sorted Archived Transactions
-    std::map<std::pair<int,int>, uint256> sortedArchive;
-    for (map<uint256, ArchiveTxPoint>::iterator it = pwalletMain->mapArcTxs.begin(); it != pwalletMain->mapArcTxs.end(); ++it)
-    {
-      uint256 txid = (*it).first;
-      ArchiveTxPoint arcTxPt = (*it).second;
-      std::pair<int,int> key;
-
-      std::set<uint256>::iterator txit;
-      txit = txids.find(txid);
-      if (txit == txids.end()) {
-          continue;
-      }
-
-      if (!arcTxPt.hashBlock.IsNull() && mapBlockIndex.count(arcTxPt.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[arcTxPt.hashBlock]->nHeight, arcTxPt.nIndex);
-        sortedArchive[key] = txid;
-      }
+        for (const uint256& txid : ait->second) {
+            std::pair<int,int> position;
+            if (pwalletMain->GetArcTxPosition(txid, position))
+                addressArchive[position] = txid;
+        }
     }
 
-    //add any missing wallet transactions - unconfimred & conflicted
-    int nPosUnconfirmed = 0;
-    for (map<uint256,CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
-      CWalletTx wtx = (*it).second;
-      std::pair<int,int> key;
-
-      if (wtx.GetDepthInMainChain() == 0) {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      } else if (!wtx.hashBlock.IsNull() && mapBlockIndex.count(wtx.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[wtx.hashBlock]->nHeight, wtx.nIndex);
-        sortedArchive[key] = wtx.GetHash();
-      } else {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      }
-
-    }
+    //Wallet transactions, including unconfimred & conflicted
+    TxPositionMap walletPositions;
+    getWalletTxPositions(walletPositions);
 
     uint64_t t = GetTime();
     int chainHeight = chainActive.Tip()->nHeight;
-    //Reverse Iterate thru transactions
-    for (map<std::pair<int,int>, uint256>::reverse_iterator it = sortedArchive.rbegin(); it != sortedArchive.rend(); ++it)
+    //Iterate thru transactions from newest to oldest, starting after the paging cursor
+    TxPositionCursor cursor(walletPositions, addressArchive);
+    if (!startAfter.IsNull() && !cursor.StartAfter(startAfter))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start after transaction id not found in the wallet");
+
+    std::pair<int,int> position;
+    uint256 txid;
+    while (cursor.Next(position, txid))
     {
-        uint256 txid = (*it).second;
         RpcArcTransaction arcTx;
 
-        //Exclude transactions with block height lower the type 3 filter minimum
-        if (nFilterType == 3 && (*it).first.first < nFilter)
-            continue;
+        //Exclude transactions with block height lower the type 3 filter minimum, all the rest are older
+        if (nFilterType == 3 && position.first < nFilter)
+            break;
 
         if (pwalletMain->mapWallet.count(txid)) {
 
@@ -1563,7 +1614,7 @@ UniValue zs_listspentbyaddress(const UniValue& params, bool fHelp, const CPubKey
 
         } else {
 
-            int confirms = chainHeight - (*it).first.first + 1;
+            int confirms = chainHeight - position.first + 1;
 
             //Excude transactions with less confirmations than required
             if (confirms < nMinConfirms)
@@ -1629,7 +1680,7 @@ UniValue zs_listreceivedbyaddress(const UniValue& params, bool fHelp, const CPub
   if (!EnsureWalletIsAvailable(fHelp))
       return NullUniValue;
 
-  if (fHelp || params.size() > 5 || params.size() == 3 || params.size() < 1)
+  if (fHelp || params.size() > 6 || params.size() == 3 || params.size() < 1)
       throw runtime_error(
         "zs_listreceivedbyaddress\n"
         "\nReturns decrypted Pirate received outputs for a single address.\n"
@@ -1656,11 +1707,16 @@ UniValue zs_listreceivedbyaddress(const UniValue& params, bool fHelp, const CPub
         "5. \"Count:\"                 (numeric, optional, default=100000) \n"
         "                               Last n number of transactions returned\n"
         "\n"
+        "6. \"Start After:\"           (string, optional, default=\"\") \n"
+        "                               Transaction id to page from, only transactions older than it are returned.\n"
+        "                               Pass the txid of the first (oldest) transaction of the previous call to get the next page.\n"
+        "\n"
         "Default Parameters:\n"
         "2. 0 - O confimations required\n"
         "3. 0 - Returns all transactions\n"
         "4. 0 - Ignored\n"
         "5. 100000 - Return the last 9,999,999 transactions.\n"
+        "6. \"\" - Start from the newest transaction\n"
         "\n"
         "\nResult:\n"
         "   \"txid\":  \"transactionid\",           (string)  The transaction id.\n"
@@ -1712,10 +1768,15 @@ UniValue zs_listreceivedbyaddress(const UniValue& params, bool fHelp, const CPub
       nFilter = params[3].get_int64();
     }
 
-    if (params.size() == 5) {
+    if (params.size() >= 5) {
       nCount = params[4].get_int64();
     }
 
+    uint256 startAfter;
+    if (params.size() == 6 && !params[5].get_str().empty()) {
+        startAfter = ParseHashV(params[5], "Start After");
+    }
+
     bool fIncludeWatchonly = true;
 
     if (nMinConfirms < 0)
@@ -1755,66 +1816,37 @@ UniValue zs_listreceivedbyaddress(const UniValue& params, bool fHelp, const CPub
     if (!isTAddress && !isZcAddress && !isZsAddress)
         return ret;
 
-    //Get set of txids that the encoded address was used in
-    std::map<std::string, std::set<uint256>>::iterator ait;
-    ait = pwalletMain->mapAddressTxids.find(encodedAddress);
-    std::set<uint256> txids;
+    //Archived transactions the encoded address was used in, found through the address index
+    TxPositionMap addressArchive;
+    std::map<std::string, std::set<uint256>>::iterator ait = pwalletMain->mapAddressTxids.find(encodedAddress);
     if (ait != pwalletMain->mapAddressTxids.end()) {
-        txids = ait->second;
-    }
-
-    //get Sorted Archived Transactions
-    std::map<std::pair<int,int>, uint256> sortedArchive;
-    for (map<uint256, ArchiveTxPoint>::iterator it = pwalletMain->mapArcTxs.begin(); it != pwalletMain->mapArcTxs.end(); ++it)
-    {
-      uint256 txid = (*it).first;
-      ArchiveTxPoint arcTxPt = (*it).second;
-      std::pair<int,int> key;
-
-      std::set<uint256>::iterator txit;
-      txit = txids.find(txid);
-      if (txit == txids.end()) {
-          continue;
-      }
-
-      if (!arcTxPt.hashBlock.IsNull() && mapBlockIndex.count(arcTxPt.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[arcTxPt.hashBlock]->nHeight, arcTxPt.nIndex);
-        sortedArchive[key] = txid;
-      }
+        for (const uint256& txid : ait->second) {
+            std::pair<int,int> position;
+            if (pwalletMain->GetArcTxPosition(txid, position))
+                addressArchive[position] = txid;
+        }
     }
 
-    //add any missing wallet transactions - unconfimred & conflicted
-    int nPosUnconfirmed = 0;
-    for (map<uint256,CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
-      CWalletTx wtx = (*it).second;
-      std::pair<int,int> key;
-
-      if (wtx.GetDepthInMainChain() == 0) {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      } else if (!wtx.hashBlock.IsNull() && mapBlockIndex.count(wtx.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[wtx.hashBlock]->nHeight, wtx.nIndex);
-        sortedArchive[key] = wtx.GetHash();
-      } else {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      }
-
-    }
+    //Wallet transactions, including unconfimred & conflicted
+    TxPositionMap walletPositions;
+    getWalletTxPositions(walletPositions);
 
     uint64_t t = GetTime();
     int chainHeight = chainActive.Tip()->nHeight;
-    //Reverse Iterate thru transactions
-    for (map<std::pair<int,int>, uint256>::reverse_iterator it = sortedArchive.rbegin(); it != sortedArchive.rend(); ++it)
+    //Iterate thru transactions from newest to oldest, starting after the paging cursor
+    TxPositionCursor cursor(walletPositions, addressArchive);
+    if (!startAfter.IsNull() && !cursor.StartAfter(startAfter))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start after transaction id not found in the wallet");
+
+    std::pair<int,int> position;
+    uint256 txid;
+    while (cursor.Next(position, txid))
     {
-        uint256 txid = (*it).second;
         RpcArcTransaction arcTx;
 
-        //Exclude transactions with block height lower the type 3 filter minimum
-        if (nFilterType == 3 && (*it).first.first < nFilter)
-            continue;
+        //Exclude transactions with block height lower the type 3 filter minimum, all the rest are older
+        if (nFilterType == 3 && position.first < nFilter)
+            break;
 
         if (pwalletMain->mapWallet.count(txid)) {
 
@@ -1848,7 +1880,7 @@ UniValue zs_listreceivedbyaddress(const UniValue& params, bool fHelp, const CPub
 
         } else {
 
-            int confirms = chainHeight - (*it).first.first + 1;
+            int confirms = chainHeight - position.first + 1;
 
             //Excude transactions with less confirmations than required
             if (confirms < nMinConfirms)
@@ -1914,7 +1946,7 @@ UniValue zs_listsentbyaddress(const UniValue& params, bool fHelp, const CPubKey&
   if (!EnsureWalletIsAvailable(fHelp))
       return NullUniValue;
 
-  if (fHelp || params.size() > 5 || params.size() == 3 || params.size() < 1)
+  if (fHelp || params.size() > 6 || params.size() == 3 || params.size() < 1)
       throw runtime_error(
         "zs_listsentbyaddress\n"
         "\nReturns decrypted Pirate outputs sent to a single address.\n"
@@ -1941,11 +1973,16 @@ UniValue zs_listsentbyaddress(const UniValue& params, bool fHelp, const CPubKey&
         "5. \"Count:\"                 (numeric, optional, default=100000) \n"
         "                               Last n number of transactions returned\n"
         "\n"
+        "6. \"Start After:\"           (string, optional, default=\"\") \n"
+        "                               Transaction id to page from, only transactions older than it are returned.\n"
+        "                               Pass the txid of the first (oldest) transaction of the previous call to get the next page.\n"
+        "\n"
         "Default Parameters:\n"
         "2. 0 - O confimations required\n"
         "3. 0 - Returns all transactions\n"
         "4. 0 - Ignored\n"
         "5. 100000 - Return the last 9,999,999 transactions.\n"
+        "6. \"\" - Start from the newest transaction\n"
         "\n"
         "\nResult:\n"
         "   \"txid\":  \"transactionid\",           (string)  The transaction id.\n"
@@ -1996,10 +2033,15 @@ UniValue zs_listsentbyaddress(const UniValue& params, bool fHelp, const CPubKey&
       nFilter = params[3].get_int64();
     }
 
-    if (params.size() == 5) {
+    if (params.size() >= 5) {
       nCount = params[4].get_int64();
     }
 
+    uint256 startAfter;
+    if (params.size() == 6 && !params[5].get_str().empty()) {
+        startAfter = ParseHashV(params[5], "Start After");
+    }
+
     bool fIncludeWatchonly = true;
 
     if (nMinConfirms < 0)
@@ -2041,67 +2083,37 @@ UniValue zs_listsentbyaddress(const UniValue& params, bool fHelp, const CPubKey&
     if (!isTAddress && !isZcAddress && !isZsAddress)
         return ret;
 
-    //Get set of txids that the encoded address was used in
-    std::map<std::string, std::set<uint256>>::iterator ait;
-    ait = pwalletMain->mapAddressTxids.find(encodedAddress);
-    std::set<uint256> txids;
-
+    //Archived transactions the encoded address was used in, found through the address index
+    TxPositionMap addressArchive;
+    std::map<std::string, std::set<uint256>>::iterator ait = pwalletMain->mapAddressTxids.find(encodedAddress);
     if (ait != pwalletMain->mapAddressTxids.end()) {
-        txids = ait->second;
-    }
-
-    //get Sorted Archived Transactions
-    std::map<std::pair<int,int>, uint256> sortedArchive;
-    for (map<uint256, ArchiveTxPoint>::iterator it = pwalletMain->mapArcTxs.begin(); it != pwalletMain->mapArcTxs.end(); ++it)
-    {
-      uint256 txid = (*it).first;
-      ArchiveTxPoint arcTxPt = (*it).second;
-      std::pair<int,int> key;
-
-      std::set<uint256>::iterator txit;
-      txit = txids.find(txid);
-      if (txit == txids.end()) {
-          continue;
-      }
-
-      if (!arcTxPt.hashBlock.IsNull() && mapBlockIndex.count(arcTxPt.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[arcTxPt.hashBlock]->nHeight, arcTxPt.nIndex);
-        sortedArchive[key] = txid;
-      }
+        for (const uint256& txid : ait->second) {
+            std::pair<int,int> position;
+            if (pwalletMain->GetArcTxPosition(txid, position))
+                addressArchive[position] = txid;
+        }
     }
 
-    //add any missing wallet transactions - unconfimred & conflicted
-    int nPosUnconfirmed = 0;
-    for (map<uint256,CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
-      CWalletTx wtx = (*it).second;
-      std::pair<int,int> key;
-
-      if (wtx.GetDepthInMainChain() == 0) {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      } else if (!wtx.hashBlock.IsNull() && mapBlockIndex.count(wtx.hashBlock) > 0) {
-        key = make_pair(mapBlockIndex[wtx.hashBlock]->nHeight, wtx.nIndex);
-        sortedArchive[key] = wtx.GetHash();
-      } else {
-        key = make_pair(chainActive.Tip()->nHeight + 1,  nPosUnconfirmed);
-        sortedArchive[key] = wtx.GetHash();
-        nPosUnconfirmed++;
-      }
-
-    }
+    //Wallet transactions, including unconfimred & conflicted
+    TxPositionMap walletPositions;
+    getWalletTxPositions(walletPositions);
 
     uint64_t t = GetTime();
     int chainHeight = chainActive.Tip()->nHeight;
-    //Reverse Iterate thru transactions
-    for (map<std::pair<int,int>, uint256>::reverse_iterator it = sortedArchive.rbegin(); it != sortedArchive.rend(); ++it)
+    //Iterate thru transactions from newest to oldest, starting after the paging cursor
+    TxPositionCursor cursor(walletPositions, addressArchive);
+    if (!startAfter.IsNull() && !cursor.StartAfter(startAfter))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start after transaction id not found in the wallet");
+
+    std::pair<int,int> position;
+    uint256 txid;
+    while (cursor.Next(position, txid))
     {
-        uint256 txid = (*it).second;
         RpcArcTransaction arcTx;
 
-        //Exclude transactions with block height lower the type 3 filter minimum
-        if (nFilterType == 3 && (*it).first.first < nFilter)
-            continue;
+        //Exclude transactions with block height lower the type 3 filter minimum, all the rest are older
+        if (nFilterType == 3 && position.first < nFilter)
+            break;
 
         if (pwalletMain->mapWallet.count(txid)) {
 
@@ -2136,7 +2148,7 @@ UniValue zs_listsentbyaddress(const UniValue& params, bool fHelp, const CPubKey&
 
         } else {
 
-            int confirms = chainHeight - (*it).first.first + 1;
+            int confirms = chainHeight - position.first + 1;
 
             //Excude transactions with less confirmations than required
             if (confirms < nMinConfirms)
@@ -2394,52 +2406,6 @@ UniValue getalldata(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
       }
 
-      for (auto & pair : wtx.mapSaplingNoteData) {
-          SaplingOutPoint op = pair.first;
-          SaplingNoteData nd = pair.second;
-
-          //Skip Spent
-          if (nd.nullifier && pwalletMain->IsSaplingSpent(*nd.nullifier))
-              continue;
-
-          //Decrypt sapling incoming commitments using IVK
-          auto ivk = nd.ivk;
-          libzcash::SaplingExtendedFullViewingKey extfvk;
-          if(pwalletMain->GetSaplingFullViewingKey(ivk, extfvk)) {
-              bool haveSpendingKey = pwalletMain->HaveSaplingSpendingKey(extfvk);
-              if (haveSpendingKey || fIncludeWatchonly) {
-
-                  auto pt = libzcash::SaplingNotePlaintext::decrypt(Params().GetConsensus(), txHeight,
-                      wtx.vShieldedOutput[op.n].encCiphertext,ivk,wtx.vShieldedOutput[op.n].ephemeralKey,wtx.vShieldedOutput[op.n].cmu);
-
-                  if (txType == 0 && pwalletMain->IsLockedNote(op))
-                      txType = 3;
-
-                  auto note = pt.get();
-                  auto pa = ivk.address(note.d);
-                  auto addr = pa.get();
-                  string addressString = EncodePaymentAddress(addr);
-                  if (addressBalances.count(addressString) == 0)
-                      addressBalances.insert(make_pair(addressString,txAmounts));
-
-                  if (txType == 0) {
-                      addressBalances.at(addressString).confirmed += note.value();
-                      privateConfirmed += note.value();
-                  } else if (txType == 1) {
-                      addressBalances.at(addressString).immature += note.value();
-                      privateImmature += note.value();
-                  } else if (txType == 2) {
-                      addressBalances.at(addressString).unconfirmed += note.value();
-                      privateUnconfirmed += note.value();
-                  } else if (txType == 3) {
-                      addressBalances.at(addressString).locked += note.value();
-                      privateLocked += note.value();
-                  }
-                  addressBalances.at(addressString).spendable = haveSpendingKey;
-              }
-          }
-      }
-
       for (auto & pair : wtx.mapSproutNoteData) {
           JSOutPoint jsop = pair.first;
           SproutNoteData nd = pair.second;
@@ -2493,6 +2459,29 @@ UniValue getalldata(const UniValue& params, bool fHelp, const CPubKey& mypk)
     }
 
 
+    //Add Sapling notes, the wallet keeps them summed per address
+    for (const auto& entry : pwalletMain->GetSaplingBalances()) {
+        const CWallet::SaplingAddressBalances& noteBalances = entry.second;
+        if (!noteBalances.spendable && !fIncludeWatchonly)
+            continue;
+
+        string addressString = EncodePaymentAddress(entry.first);
+        if (addressBalances.count(addressString) == 0)
+            addressBalances.insert(make_pair(addressString,txAmounts));
+
+        balancestruct& addressBalance = addressBalances.at(addressString);
+        addressBalance.confirmed += noteBalances.Confirmed(nMinDepth);
+        addressBalance.unconfirmed += noteBalances.Unconfirmed();
+        addressBalance.locked += noteBalances.Locked();
+        addressBalance.immature += noteBalances.immature;
+        addressBalance.spendable = noteBalances.spendable;
+
+        privateConfirmed += noteBalances.Confirmed(nMinDepth);
+        privateUnconfirmed += noteBalances.Unconfirmed();
+        privateLocked += noteBalances.Locked();
+        privateImmature += noteBalances.immature;
+    }
+
     CAmount nBalance = 0;
     CAmount nBalanceUnconfirmed = 0;
     CAmount nBalanceTotal = 0;
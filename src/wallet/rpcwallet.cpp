@@ -3381,10 +3381,15 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             "\n"
             "Runs a benchmark of the selected type samplecount times,\n"
             "returning the running times of each sample.\n"
+            "The rescan benchmark takes an optional block count (default 1000)\n"
+            "and also reports the scan rate of each sample. It rescans the blocks into\n"
+            "a scratch wallet holding the Sapling viewing keys of the wallet, the wallet\n"
+            "itself is not changed.\n"
             "\n"
             "Output: [\n"
             "  {\n"
-            "    \"runningtime\": runningtime\n"
+            "    \"runningtime\": runningtime,\n"
+            "    \"blockspersecond\": rate      (rescan only)\n"
             "  },\n"
             "  {\n"
             "    \"runningtime\": runningtime\n"
@@ -3404,6 +3409,7 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
     }
 
     std::vector<double> sample_times;
+    int nRescanBlocks = 1000;
 
     JSDescription samplejoinsplit;
 
@@ -3472,6 +3478,15 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_loadwallet());
         } else if (benchmarktype == "listunspent") {
             sample_times.push_back(benchmark_listunspent());
+        } else if (benchmarktype == "rescan") {
+            if (params.size() >= 3) {
+                nRescanBlocks = params[2].get_int();
+            }
+            if (nRescanBlocks <= 0) {
+                throw JSONRPCError(RPC_TYPE_ERROR, "Invalid block count");
+            }
+            nRescanBlocks = std::min(nRescanBlocks, chainActive.Height() + 1);
+            sample_times.push_back(benchmark_rescan(nRescanBlocks));
         } else if (benchmarktype == "createsaplingspend") {
             sample_times.push_back(benchmark_create_sapling_spend());
         } else if (benchmarktype == "createsaplingoutput") {
@@ -3489,6 +3504,9 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
     for (auto time : sample_times) {
         UniValue result(UniValue::VOBJ);
         result.push_back(Pair("runningtime", time));
+        if (benchmarktype == "rescan" && time > 0) {
+            result.push_back(Pair("blockspersecond", nRescanBlocks / time));
+        }
         results.push_back(result);
     }
 
@@ -3717,16 +3735,40 @@ CAmount getBalanceTaddr(std::string transparentAddress, int minDepth=1, bool ign
 }
 
 CAmount getBalanceZaddr(std::string address, int minDepth = 1, bool ignoreUnspendable=true) {
+    // Sapling notes come from the per-address balances, Sprout notes from GetFilteredNotes
+    boost::optional<libzcash::SaplingPaymentAddress> saplingAddress;
+    std::set<libzcash::PaymentAddress> sproutAddresses;
+    if (address.length() > 0) {
+        auto pa = DecodePaymentAddress(address);
+        auto zaddr = boost::get<libzcash::SaplingPaymentAddress>(&pa);
+        if (zaddr != nullptr)
+            saplingAddress = *zaddr;
+        else
+            sproutAddresses.insert(pa);
+    } else {
+        std::set<libzcash::SproutPaymentAddress> setSprout;
+        pwalletMain->GetSproutPaymentAddresses(setSprout);
+        sproutAddresses.insert(setSprout.begin(), setSprout.end());
+    }
+
     CAmount balance = 0;
-    std::vector<CSproutNotePlaintextEntry> sproutEntries;
-    std::vector<SaplingNoteEntry> saplingEntries;
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-    pwalletMain->GetFilteredNotes(sproutEntries, saplingEntries, address, minDepth, true, ignoreUnspendable);
-    for (auto & entry : sproutEntries) {
-        balance += CAmount(entry.plaintext.value());
+    if (!sproutAddresses.empty()) {
+        std::vector<CSproutNotePlaintextEntry> sproutEntries;
+        std::vector<SaplingNoteEntry> saplingEntries;
+        pwalletMain->GetFilteredNotes(sproutEntries, saplingEntries, sproutAddresses, minDepth, INT_MAX, true, ignoreUnspendable);
+        for (auto & entry : sproutEntries) {
+            balance += CAmount(entry.plaintext.value());
+        }
+        if (!address.empty())
+            return balance;
     }
-    for (auto & entry : saplingEntries) {
-        balance += CAmount(entry.note.value());
+
+    for (const auto& entry : pwalletMain->GetSaplingBalances()) {
+        if (saplingAddress && !(entry.first == *saplingAddress))
+            continue;
+        if (ignoreUnspendable && !entry.second.spendable)
+            continue;
+        balance += entry.second.Confirmed(minDepth);
     }
     return balance;
 }
@@ -216,6 +216,47 @@ public:
         return true;
     }
 
+    /**
+     * Get the Merkle paths of several notes and their common anchor with a
+     * single call into the wallet. cmus holds the note commitment of each note.
+     */
+    bool GetMerklePathsOfNotes(const std::vector<std::pair<uint256, int>> &notes, const std::vector<uint256> &cmus, std::vector<libzcash::MerklePath> &merklePaths, uint256 &anchor) {
+        assert(notes.size() == cmus.size());
+        if (notes.empty()) {
+            return false;
+        }
+
+        std::vector<unsigned char> txids(notes.size() * 32);
+        std::vector<size_t> outidxs(notes.size());
+        std::vector<unsigned char> cmuBytes(notes.size() * 32);
+        for (size_t i = 0; i < notes.size(); i++) {
+            std::copy(notes[i].first.begin(), notes[i].first.end(), txids.begin() + i * 32);
+            outidxs[i] = notes[i].second;
+            std::copy(cmus[i].begin(), cmus[i].end(), cmuBytes.begin() + i * 32);
+        }
+
+        std::vector<unsigned char> serializedPaths(notes.size() * 1065);
+        if (!sapling_wallet_get_paths_for_notes(
+              inner.get(),
+              txids.data(),
+              outidxs.data(),
+              cmuBytes.data(),
+              notes.size(),
+              serializedPaths.data(),
+              anchor.begin())) {
+            return false;
+        }
+
+        merklePaths.resize(notes.size());
+        for (size_t i = 0; i < notes.size(); i++) {
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss.write((const char*)serializedPaths.data() + i * 1065, 1065);
+            ss >> merklePaths[i];
+        }
+
+        return true;
+    }
+
     bool GetPathRootWithCMU(libzcash::MerklePath &merklePath, uint256 cmu, uint256 &anchor) {
         unsigned char serializedPath[1065] = {};
         unsigned char serializedAnchor[32] = {};
@@ -34,6 +34,7 @@
 #include "rpc/server.h"
 #include "script/script.h"
 #include "script/sign.h"
+#include "threadpool.h"
 #include "timedata.h"
 #include "utilmoneystr.h"
 #include "zcash/Note.hpp"
@@ -377,6 +378,7 @@ bool CWallet::AddSaplingZKey(
     const libzcash::SaplingExtendedSpendingKey &extsk)
 {
     AssertLockHeld(cs_wallet); // mapSaplingZKeyMetadata
+    MarkBalancesDirty();
 
 
     if (IsCrypted() && IsLocked()) {
@@ -479,6 +481,7 @@ bool CWallet::AddSaplingIncomingViewingKey(
 bool CWallet::AddSaplingExtendedFullViewingKey(const libzcash::SaplingExtendedFullViewingKey &extfvk)
 {
     AssertLockHeld(cs_wallet);
+    MarkBalancesDirty();
 
     if (IsCrypted() && IsLocked()) {
         return false;
@@ -1292,7 +1295,7 @@ void CWallet::ChainTip(const CBlockIndex *pindex,
     LOCK2(cs_main, cs_wallet);
 
     if (added) {
-        IncrementSaplingWallet(pindex);
+        IncrementSaplingWallet(pindex, pblock);
         // Prevent witness cache building && consolidation transactions
         // from being created when node is syncing after launch,
         // and also when node wakes up from suspension/hibernation and incoming blocks are old.
@@ -1922,14 +1925,75 @@ void CWallet::RemoveFromSaplingSpends(const uint256& wtxid)
     }
 }
 
+static bool GetArcTxPointPosition(const ArchiveTxPoint& arcTxPt, std::pair<int,int>& position)
+{
+    if (arcTxPt.hashBlock.IsNull())
+        return false;
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(arcTxPt.hashBlock);
+    if (mi == mapBlockIndex.end() || mi->second == nullptr)
+        return false;
+
+    position = std::make_pair(mi->second->nHeight, arcTxPt.nIndex);
+    return true;
+}
+
+/**
+ * Store an archived transaction, keeping mapArcTxsByPosition in step.
+ */
+static void SetArcTx(std::map<uint256, ArchiveTxPoint>& mapArcTxs, std::map<std::pair<int,int>, uint256>& mapArcTxsByPosition,
+                     const uint256& wtxid, const ArchiveTxPoint& arcTxPt)
+{
+    std::pair<int,int> position;
+    std::map<uint256, ArchiveTxPoint>::iterator it = mapArcTxs.find(wtxid);
+    if (it != mapArcTxs.end()) {
+        if (GetArcTxPointPosition(it->second, position)) {
+            std::map<std::pair<int,int>, uint256>::iterator pit = mapArcTxsByPosition.find(position);
+            if (pit != mapArcTxsByPosition.end() && pit->second == wtxid)
+                mapArcTxsByPosition.erase(pit);
+        }
+        it->second = arcTxPt;
+    } else {
+        mapArcTxs.emplace(wtxid, arcTxPt);
+    }
+
+    if (GetArcTxPointPosition(arcTxPt, position))
+        mapArcTxsByPosition[position] = wtxid;
+}
+
 void CWallet::LoadArcTxs(const uint256& wtxid, const ArchiveTxPoint& arcTxPt)
 {
-    mapArcTxs[wtxid] = arcTxPt;
+    SetArcTx(mapArcTxs, mapArcTxsByPosition, wtxid, arcTxPt);
+}
+
+bool CWallet::EraseFromArcTxs(const uint256& wtxid)
+{
+    std::map<uint256, ArchiveTxPoint>::iterator it = mapArcTxs.find(wtxid);
+    if (it == mapArcTxs.end())
+        return false;
+
+    std::pair<int,int> position;
+    if (GetArcTxPointPosition(it->second, position)) {
+        std::map<std::pair<int,int>, uint256>::iterator pit = mapArcTxsByPosition.find(position);
+        if (pit != mapArcTxsByPosition.end() && pit->second == wtxid)
+            mapArcTxsByPosition.erase(pit);
+    }
+    mapArcTxs.erase(it);
+    return true;
+}
+
+bool CWallet::GetArcTxPosition(const uint256& wtxid, std::pair<int,int>& position) const
+{
+    std::map<uint256, ArchiveTxPoint>::const_iterator it = mapArcTxs.find(wtxid);
+    if (it == mapArcTxs.end())
+        return false;
+
+    return GetArcTxPointPosition(it->second, position);
 }
 
 void CWallet::AddToArcTxs(const uint256& wtxid, ArchiveTxPoint& arcTxPt)
 {
-    mapArcTxs[wtxid] = arcTxPt;
+    SetArcTx(mapArcTxs, mapArcTxsByPosition, wtxid, arcTxPt);
 
     uint256 txid = wtxid;
     RpcArcTransaction arcTx;
@@ -1943,26 +2007,13 @@ void CWallet::AddToArcTxs(const uint256& wtxid, ArchiveTxPoint& arcTxPt)
 
     //Update Address txid map
     for (auto it = arcTx.addresses.begin(); it != arcTx.addresses.end(); ++it) {
-        std::string addr = *it;
-
-        std::set<uint256> txids;
-        std::map<std::string, std::set<uint256>>::iterator ait;
-
-        ait = mapAddressTxids.find(addr);
-        if (ait != mapAddressTxids.end()) {
-            txids = ait->second;
-        }
-
-        txids.insert(txid);
-
-        mapAddressTxids[addr] = txids;
-
+        mapAddressTxids[*it].insert(txid);
     }
 }
 
 void CWallet::AddToArcTxs(const CWalletTx& wtx, int txHeight, ArchiveTxPoint& arcTxPt)
 {
-    mapArcTxs[wtx.GetHash()] = arcTxPt;
+    SetArcTx(mapArcTxs, mapArcTxsByPosition, wtx.GetHash(), arcTxPt);
 
     CWalletTx tx = wtx;
     RpcArcTransaction arcTx;
@@ -1976,19 +2027,7 @@ void CWallet::AddToArcTxs(const CWalletTx& wtx, int txHeight, ArchiveTxPoint& ar
 
     //Update Address txid map
     for (auto it = arcTx.addresses.begin(); it != arcTx.addresses.end(); ++it) {
-        std::string addr = *it;
-        std::set<uint256> txids;
-        std::map<std::string, std::set<uint256>>::iterator ait;
-
-        ait = mapAddressTxids.find(addr);
-        if (ait != mapAddressTxids.end()) {
-            txids = ait->second;
-        }
-
-        txids.insert(arcTx.txid);
-
-        mapAddressTxids[addr] = txids;
-
+        mapAddressTxids[*it].insert(wtx.GetHash());
     }
 }
 
@@ -2207,7 +2246,7 @@ bool CWallet::ValidateSaplingWalletTrackedPositions(const CBlockIndex* pindex) {
 
 }
 
-void CWallet::IncrementSaplingWallet(const CBlockIndex* pindex) {
+void CWallet::IncrementSaplingWallet(const CBlockIndex* pindex, const CBlock* pblockIn) {
 
     AssertLockHeld(cs_main);
     AssertLockHeld(cs_wallet);
@@ -2383,10 +2422,13 @@ void CWallet::IncrementSaplingWallet(const CBlockIndex* pindex) {
 
         } else {
 
-            //Retrieve the full block to get all of the transaction commitments
+            //Retrieve the full block to get all of the transaction commitments, unless the caller already has it
             CBlock block;
-            ReadBlockFromDisk(block, pindex, 1);
-            CBlock *pblock = &block;
+            const CBlock *pblock = pblockIn;
+            if (pblock == nullptr) {
+                ReadBlockFromDisk(block, pindex, 1);
+                pblock = &block;
+            }
 
             //Create Checkpoint before incrementing wallet
             saplingWallet.CheckpointNoteCommitmentTree(pindex->nHeight);
@@ -3532,12 +3574,21 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
  * If fUpdate is true, existing transactions will be updated.
  */
 void CWallet::AddToWalletIfInvolvingMe(const std::vector<CTransaction> &vtx, std::vector<CTransaction> &vAddedTxes, const CBlock* pblock, const int nHeight, bool fUpdate, std::set<SaplingPaymentAddress>& addressesFound, bool fRescan)
+{
+    AssertLockHeld(cs_wallet);
+
+    //Step 1 -- decrypt transactions
+    AddToWalletIfInvolvingMe(vtx, FindMySaplingNotes(vtx, nHeight), vAddedTxes, pblock, nHeight, fUpdate, addressesFound, fRescan);
+}
+
+/**
+ * As above, with the Sapling trial decryption of vtx already done by the caller.
+ */
+void CWallet::AddToWalletIfInvolvingMe(const std::vector<CTransaction> &vtx, const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> &saplingNoteDataAndAddressesToAdd, std::vector<CTransaction> &vAddedTxes, const CBlock* pblock, const int nHeight, bool fUpdate, std::set<SaplingPaymentAddress>& addressesFound, bool fRescan)
 {
     {
         AssertLockHeld(cs_wallet);
 
-        //Step 1 -- decrypt transactions
-        auto saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(vtx, nHeight);
         auto saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
         auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
 
@@ -3688,6 +3739,11 @@ bool CWallet::EraseFromWallet(const uint256 &hash)
 
     LOCK(cs_wallet);
 
+    for (auto it = mapSaplingDecryptedNotes.lower_bound(SaplingOutPoint(hash, 0)); it != mapSaplingDecryptedNotes.end() && it->first.hash == hash; ) {
+        it = mapSaplingDecryptedNotes.erase(it);
+    }
+    MarkBalancesDirty();
+
     if (IsCrypted()) {
         if (!IsLocked()) {
           if (mapWallet.erase(hash)) {
@@ -3798,29 +3854,43 @@ mapSproutNoteData_t CWallet::FindMySproutNotes(const CTransaction &tx) const
 }
 
 
+struct SaplingTrialDecryptionResults
+{
+    std::vector<std::pair<SaplingOutPoint, SaplingNoteData>> vNoteData;
+    std::vector<std::pair<libzcash::SaplingPaymentAddress, SaplingIncomingViewingKey>> vViewingKeys;
+};
+
+/** Location of a shielded output within a set of blocks being scanned together */
+struct SaplingOutputIndex
+{
+    uint32_t nBlock;
+    uint32_t nTx;
+    uint32_t nOutput;
+};
+
 /**
- * Finds all output notes in the given transaction that have been sent to
- * SaplingPaymentAddresses in this wallet.
- *
- * It should never be necessary to call this method with a CWalletTx, because
- * the result of FindMySaplingNotes (for the addresses available at the time) will
- * already have been cached in CWalletTx.mapSaplingNoteData.
+ * Trial decrypt the (output, ivk) pairs with flat index in [begin, end). Pair k is output
+ * k / vIvk.size() with key k % vIvk.size(), so no per pair work list is built or copied.
+ * Results go to per block buffers owned by the calling task and are merged by the caller.
  */
-static void DecryptSaplingNoteWorker(const CWallet *wallet, std::vector<const SaplingIncomingViewingKey*> vIvk, std::vector<const OutputDescription*> vOutput, std::vector<uint32_t> vPosition, const std::vector<uint256> vHash, const int &height, mapSaplingNoteData_t *noteData, SaplingIncomingViewingKeyMap *viewingKeysToAdd, int threadNumber)
+static std::vector<SaplingTrialDecryptionResults> DecryptSaplingNoteWorker(const std::vector<const std::vector<CTransaction>*> &vvtx, const std::vector<int> &vHeight, const std::vector<SaplingOutputIndex> &vOutputIndex, const std::vector<const SaplingIncomingViewingKey*> &vIvk, const std::vector<std::vector<uint256>> &vHash, size_t begin, size_t end)
 {
-    for (int i = 0; i < vIvk.size(); i++) {
-        const SaplingIncomingViewingKey ivk = *vIvk[i];
-        const OutputDescription output = *vOutput[i];
-        const uint256 hash = vHash[i];
+    std::vector<SaplingTrialDecryptionResults> results(vvtx.size());
+    const Consensus::Params& consensusParams = Params().GetConsensus();
 
-        auto result = SaplingNotePlaintext::decrypt(Params().GetConsensus(), height, output.encCiphertext, ivk, output.ephemeralKey, output.cmu);
+    for (size_t k = begin; k < end; k++) {
+        const SaplingOutputIndex& index = vOutputIndex[k / vIvk.size()];
+        const SaplingIncomingViewingKey& ivk = *vIvk[k % vIvk.size()];
+        const OutputDescription& output = (*vvtx[index.nBlock])[index.nTx].vShieldedOutput[index.nOutput];
+
+        auto result = SaplingNotePlaintext::decrypt(consensusParams, vHeight[index.nBlock], output.encCiphertext, ivk, output.ephemeralKey, output.cmu);
         if (result) {
 
             auto address = ivk.address(result.get().d);
 
             // We don't cache the nullifier here as computing it requires knowledge of the note position
             // in the commitment tree, which can only be determined when the transaction has been mined.
-            SaplingOutPoint op {hash, vPosition[i]};
+            SaplingOutPoint op {vHash[index.nBlock][index.nTx], index.nOutput};
             SaplingNoteData nd;
             nd.ivk = ivk;
 
@@ -3832,100 +3902,85 @@ static void DecryptSaplingNoteWorker(const CWallet *wallet, std::vector<const Sa
             if (nd.value >= minTxValue) {
                 //Only add notes greater then this value
                 //dust filter
-                {
-                    LOCK(wallet->cs_wallet_threadedfunction);
-                    viewingKeysToAdd->insert(make_pair(address.get(),ivk));
-                    noteData->insert(std::make_pair(op, nd));
-                }
+                results[index.nBlock].vViewingKeys.emplace_back(address.get(), ivk);
+                results[index.nBlock].vNoteData.emplace_back(op, nd);
             }
         }
     }
+
+    return results;
 }
 
+/**
+ * Finds all output notes in the given transaction that have been sent to
+ * SaplingPaymentAddresses in this wallet.
+ *
+ * It should never be necessary to call this method with a CWalletTx, because
+ * the result of FindMySaplingNotes (for the addresses available at the time) will
+ * already have been cached in CWalletTx.mapSaplingNoteData.
+ */
 std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> CWallet::FindMySaplingNotes(const std::vector<CTransaction> &vtx, int height) const
+{
+    return FindMySaplingNotes(std::vector<const std::vector<CTransaction>*>{&vtx}, std::vector<int>{height})[0];
+}
+
+/**
+ * Block scanning variant of FindMySaplingNotes. The outputs of all blocks are
+ * trial decrypted as one job so small blocks still keep every worker busy,
+ * results are returned per block in the order the blocks were given.
+ */
+std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> CWallet::FindMySaplingNotes(const std::vector<const std::vector<CTransaction>*> &vvtx, const std::vector<int> &vHeight) const
 {
     LOCK(cs_wallet);
+    assert(vvtx.size() == vHeight.size());
 
     //Data to be collected
-    mapSaplingNoteData_t noteData;
-    SaplingIncomingViewingKeyMap viewingKeysToAdd;
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> vResults(vvtx.size());
 
-    //Create key thread buckets
-    std::vector<const SaplingIncomingViewingKey*> vIvk;
-    std::vector<std::vector<const SaplingIncomingViewingKey*>> vvIvk;
-
-    //Create OutputDescription thread buckets
-    std::vector<const OutputDescription*> vOutputDescrition;
-    std::vector<std::vector<const OutputDescription*>> vvOutputDescrition;
-
-    //Create transaction position thread buckets
-    std::vector<uint32_t> vPosition;
-    std::vector<std::vector<uint32_t>> vvPosition;
-
-    //Create transaction hash thread buckets
-    std::vector<uint256> vHash;
-    std::vector<std::vector<uint256>> vvHash;
+    if (setSaplingIncomingViewingKeys.empty()) {
+        return vResults;
+    }
 
-    for (uint32_t i = 0; i < maxProcessingThreads; i++) {
-        vvIvk.emplace_back(vIvk);
-        vvOutputDescrition.emplace_back(vOutputDescrition);
-        vvPosition.emplace_back(vPosition);
-        vvHash.emplace_back(vHash);
+    //Keys and outputs are referenced by index, nothing is copied per (ivk, output) pair
+    std::vector<const SaplingIncomingViewingKey*> vIvk;
+    vIvk.reserve(setSaplingIncomingViewingKeys.size());
+    for (const SaplingIncomingViewingKey& ivk : setSaplingIncomingViewingKeys) {
+        vIvk.emplace_back(&ivk);
     }
 
     // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
-    uint32_t t = 0;
-    for (uint32_t j = 0; j < vtx.size(); j++) {
-        //Transaction being processed
-        uint256 hash = vtx[j].GetHash();
-        for (uint32_t i = 0; i < vtx[j].vShieldedOutput.size(); i++) {
-            for (auto it = setSaplingIncomingViewingKeys.begin(); it != setSaplingIncomingViewingKeys.end(); it++) {
-                vvIvk[t].emplace_back(&(*it));
-                vvOutputDescrition[t].emplace_back(&vtx[j].vShieldedOutput[i]);
-                vvPosition[t].emplace_back(i);
-                vvHash[t].emplace_back(hash);
-                //Increment ivk vector
-                t++;
-                //reset if ivk vector is greater qty of threads being used
-                if (t >= vvIvk.size()) {
-                    t = 0;
-                }
+    std::vector<std::vector<uint256>> vHash(vvtx.size());
+    std::vector<SaplingOutputIndex> vOutputIndex;
+    for (uint32_t b = 0; b < vvtx.size(); b++) {
+        const std::vector<CTransaction>& vtx = *vvtx[b];
+        vHash[b].resize(vtx.size());
+        for (uint32_t j = 0; j < vtx.size(); j++) {
+            vHash[b][j] = vtx[j].GetHash();
+            for (uint32_t i = 0; i < vtx[j].vShieldedOutput.size(); i++) {
+                vOutputIndex.push_back({b, j, i});
             }
         }
     }
 
-
-    std::vector<boost::thread*> decryptionThreads;
-    for (uint32_t i = 0; i < vvIvk.size(); ++i) {
-        if(!vvIvk[i].empty()) {
-            decryptionThreads.emplace_back(new boost::thread(DecryptSaplingNoteWorker, this, vvIvk[i], vvOutputDescrition[i], vvPosition[i], vvHash[i], height, &noteData, &viewingKeysToAdd, i));
-        }
-    }
-
-    // Cleanup
-    for (auto dthread : decryptionThreads) {
-        dthread->join();
-        delete dthread;
-    }
-
-    //clean up pointers
-    for (uint32_t i = 0; i < vvOutputDescrition.size(); i++) {
-        for (auto pOutputDescrition : vOutputDescrition) {
-            delete pOutputDescrition;
-        }
-        vvOutputDescrition[i].resize(0);
+    //Every trial decryption costs the same, split the pairs evenly across the processing pool
+    CThreadPool& pool = GetProcessingThreadPool();
+    std::vector<std::future<std::vector<SaplingTrialDecryptionResults>>> vFutures;
+    for (const auto& chunk : PartitionEvenly(vOutputIndex.size() * vIvk.size(), std::max(pool.Size(), 1))) {
+        vFutures.emplace_back(pool.Submit([&, chunk]() {
+            return DecryptSaplingNoteWorker(vvtx, vHeight, vOutputIndex, vIvk, vHash, chunk.first, chunk.second);
+        }));
     }
-    vvOutputDescrition.resize(0);
 
-    for (uint32_t i = 0; i < vvIvk.size(); i++) {
-        for (auto pIvk : vIvk) {
-            delete pIvk;
+    //Merge the per task results once every task has finished
+    for (auto &future : vFutures) {
+        std::vector<SaplingTrialDecryptionResults> results = pool.Wait(future);
+        for (size_t b = 0; b < results.size(); b++) {
+            vResults[b].first.insert(results[b].vNoteData.begin(), results[b].vNoteData.end());
+            vResults[b].second.insert(results[b].vViewingKeys.begin(), results[b].vViewingKeys.end());
         }
-        vvIvk[i].resize(0);
     }
-    vvIvk.resize(0);
 
-    return std::make_pair(noteData, viewingKeysToAdd);
+    return vResults;
 }
 
 bool CWallet::IsSproutNullifierFromMe(const uint256& nullifier) const
@@ -3985,8 +4040,10 @@ bool CWallet::GetSaplingNoteMerklePaths(std::vector<SaplingOutPoint> notes,
 {
     LOCK(cs_wallet);
     saplingMerklePaths.resize(notes.size());
-    boost::optional<uint256> rt;
-    int i = 0;
+
+    //Collect the notes the wallet holds data for, the paths are retrieved together
+    std::vector<std::pair<uint256, int>> vNotes;
+    std::vector<uint256> vCmu;
     for (SaplingOutPoint op : notes) {
 
         const CWalletTx* wtx = GetWalletTx(op.hash);
@@ -3995,37 +4052,27 @@ bool CWallet::GetSaplingNoteMerklePaths(std::vector<SaplingOutPoint> notes,
         }
 
         if (wtx->mapSaplingNoteData.count(op)) {
+            vNotes.emplace_back(op.hash, op.n);
+            vCmu.emplace_back(wtx->vShieldedOutput[op.n].cmu);
+        }
+    }
 
-            if (!saplingWallet.GetMerklePathOfNote(op.hash, op.n, saplingMerklePaths[i])) {
-                return false;
-            }
-
-            LogPrintf("\nGot Path\n");
-
-            //Calculate the anchor
-            uint256 anchor;
-            OutputDescription output = wtx->vShieldedOutput[op.n];
-            if (!saplingWallet.GetPathRootWithCMU(saplingMerklePaths[i], output.cmu, anchor)) {
-                return false;
-            }
-
-            LogPrintf("Got Anchor %s\n\n", anchor.ToString());
-            LogPrintf("Sapling Wallet Anchor %s\n\n", saplingWallet.GetLatestAnchor().ToString());
+    if (vNotes.empty()) {
+        return true;
+    }
 
-            //Check first anchor found and assert all following achors match
-            if (!rt) {
-                rt = anchor;
-            } else {
-                assert(*rt == anchor);
-            }
-            i++;
-        }
+    //All paths are taken against the same anchor, the wallet checks they agree
+    std::vector<MerklePath> vPaths;
+    uint256 anchor;
+    if (!saplingWallet.GetMerklePathsOfNotes(vNotes, vCmu, vPaths, anchor)) {
+        return false;
     }
+    std::copy(vPaths.begin(), vPaths.end(), saplingMerklePaths.begin());
+
+    LogPrint("saplingwallet", "Sapling Wallet - Got %i paths with anchor %s\n", vPaths.size(), anchor.ToString());
 
     // All returned witnesses have the same anchor
-    if (rt) {
-        final_anchor = *rt;
-    }
+    final_anchor = anchor;
 
     return true;
 }
@@ -4453,6 +4500,20 @@ bool CWallet::LoadCryptedHDSeed(const uint256& seedFp, const std::vector<unsigne
     return CCryptoKeyStore::SetCryptedHDSeed(seedFp, seed);
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalancesDirty();
+}
+
 void CWalletTx::SetSproutNoteData(mapSproutNoteData_t &noteData)
 {
     mapSproutNoteData.clear();
@@ -4989,7 +5050,7 @@ bool CWallet::DeleteTransactions(std::vector<uint256> &removeTxs, std::vector<ui
 
     //Remove Conflicted ArcTx transactions from the wallet database
     for (int i = 0; i < removeArcTxs.size(); i++) {
-        if (mapArcTxs.erase(removeArcTxs[i])) {
+        if (EraseFromArcTxs(removeArcTxs[i])) {
             walletdb.EraseArcTx(removeArcTxs[i]);
             //remove conflicted transactions from GUI
             if (!fRescan) {
@@ -5349,56 +5410,94 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate, b
           SaplingWalletReset();
         }
 
-        while (pindex)
+        //Blocks are read and checked on the processing pool ahead of the scan
+        CThreadPool& pool = GetProcessingThreadPool();
+        std::deque<std::pair<CBlockIndex*, std::future<std::shared_ptr<CBlock>>>> vPrefetch;
+        CBlockIndex* pindexPrefetch = pindex;
+        auto prefetchBlocks = [&]() {
+            while (pindexPrefetch && vPrefetch.size() < 2 * WALLET_RESCAN_WINDOW) {
+                vPrefetch.emplace_back(pindexPrefetch, pool.Submit([pindexRead = pindexPrefetch]() {
+                    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+                    ReadBlockFromDisk(*pblock, pindexRead, 1);
+                    return pblock;
+                }));
+                pindexPrefetch = chainActive.Next(pindexPrefetch);
+            }
+        };
+
+        bool fShutdown = false;
+        while (!vPrefetch.empty() || pindexPrefetch)
         {
             //exit loop if trying to shutdown
             if (ShutdownRequested()) {
                 break;
             }
 
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-            {
-                scanperc = (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100);
-                uiInterface.ShowProgress(_(("Rescanning - Currently on block " + std::to_string(pindex->nHeight) + "...").c_str()), std::max(1, std::min(99, scanperc)), false);
+            //Take the next window of blocks and queue the reads of the window after it
+            prefetchBlocks();
+            std::vector<std::pair<CBlockIndex*, std::shared_ptr<CBlock>>> vWindow;
+            while (!vPrefetch.empty() && vWindow.size() < WALLET_RESCAN_WINDOW) {
+                vWindow.emplace_back(vPrefetch.front().first, pool.Wait(vPrefetch.front().second));
+                vPrefetch.pop_front();
             }
+            prefetchBlocks();
 
-            bool blockInvolvesMe = false;
-            CBlock block;
-            ReadBlockFromDisk(block, pindex,1);
+            //Trial decrypt the whole window at once, the set of ivks is not changed by adding notes
+            std::vector<const std::vector<CTransaction>*> vvtx;
+            std::vector<int> vHeight;
+            for (const auto& entry : vWindow) {
+                vvtx.emplace_back(&entry.second->vtx);
+                vHeight.emplace_back(entry.first->nHeight);
+            }
+            auto vSaplingNotes = FindMySaplingNotes(vvtx, vHeight);
 
-            std::vector<CTransaction> vOurs;
-            AddToWalletIfInvolvingMe(block.vtx, vOurs, &block, pindex->nHeight, fUpdate, addressesFound, true);
+            //Add transactions and commitments in chain order
+            for (size_t nBlock = 0; nBlock < vWindow.size(); nBlock++) {
+                if (ShutdownRequested()) {
+                    fShutdown = true;
+                    break;
+                }
 
-            for (int i = 0; i < vOurs.size(); i++) {
-                blockInvolvesMe = true;
-                txList.insert(vOurs[i].GetHash());
-                ret++;
-            }
+                pindex = vWindow[nBlock].first;
+                const CBlock& block = *vWindow[nBlock].second;
 
-            IncrementSaplingWallet(pindex);
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                {
+                    scanperc = (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100);
+                    uiInterface.ShowProgress(_(("Rescanning - Currently on block " + std::to_string(pindex->nHeight) + "...").c_str()), std::max(1, std::min(99, scanperc)), false);
+                }
 
-            SproutMerkleTree sproutTree;
-            SaplingMerkleTree saplingTree;
-            SaplingMerkleFrontier saplingFrontierTree;
-            // This should never fail: we should always be able to get the tree
-            // state on the path to the tip of our chain
-            assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
-            if (pindex->pprev) {
-                if (NetworkUpgradeActive(pindex->pprev->nHeight, Params().GetConsensus(), Consensus::UPGRADE_SAPLING)) {
-                    assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
-                    assert(pcoinsTip->GetSaplingFrontierAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingFrontierTree));
+                bool blockInvolvesMe = false;
+
+                std::vector<CTransaction> vOurs;
+                AddToWalletIfInvolvingMe(block.vtx, vSaplingNotes[nBlock], vOurs, &block, pindex->nHeight, fUpdate, addressesFound, true);
+
+                for (int i = 0; i < vOurs.size(); i++) {
+                    blockInvolvesMe = true;
+                    txList.insert(vOurs[i].GetHash());
+                    ret++;
                 }
-            }
 
-            //Delete Transactions
-            if (pindex->nHeight % fDeleteInterval == 0)
-                while(DeleteWalletTransactions(pindex, true)) {}
+                IncrementSaplingWallet(pindex, &block);
+
+                //Delete Transactions
+                if (pindex->nHeight % fDeleteInterval == 0)
+                    while(DeleteWalletTransactions(pindex, true)) {}
 
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                }
             }
-            pindex = chainActive.Next(pindex);
+
+            if (fShutdown) {
+                break;
+            }
+        }
+
+        //Outstanding reads use the block index, finish them while cs_main is still held
+        for (auto& entry : vPrefetch) {
+            pool.Wait(entry.second);
         }
 
         uiInterface.ShowProgress(_("Rescanning..."), 100, false); // hide progress dialog in GUI
@@ -5796,94 +5895,146 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
  */
 
 
-CAmount CWallet::GetBalance() const
+CWallet::BalancesKey CWallet::GetBalancesKey() const
 {
-    CAmount nTotal = 0;
+    AssertLockHeld(cs_main);
+    return BalancesKey{nBalancesGeneration, chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256(),
+                       mempool.GetTransactionsUpdated()};
+}
+
+CWallet::Balances CWallet::GetBalances() const
+{
+    LOCK2(cs_main, cs_wallet);
+    BalancesKey key = GetBalancesKey();
+    if (cachedBalancesKey && *cachedBalancesKey == key) {
+        return cachedBalances;
+    }
+
+    Balances ret;
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        const CWalletTx* pcoin = &(*it).second;
+        bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted) {
+            ret.mine_trusted += pcoin->GetAvailableCredit();
+            ret.watchonly_trusted += pcoin->GetAvailableWatchOnlyCredit();
         }
+        if (!CheckFinalTx(*pcoin) || (!fTrusted && pcoin->GetDepthInMainChain() == 0)) {
+            ret.mine_untrusted_pending += pcoin->GetAvailableCredit();
+            ret.watchonly_untrusted_pending += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        ret.mine_immature += pcoin->GetImmatureCredit();
+        ret.watchonly_immature += pcoin->GetImmatureWatchOnlyCredit();
     }
 
-    return nTotal;
+    cachedBalances = ret;
+    cachedBalancesKey = key;
+    return ret;
 }
 
-CAmount CWallet::GetUnconfirmedBalance() const
+static CAmount SumFromDepth(const std::map<int, CAmount>& mapDepths, int minDepth)
 {
     CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!CheckFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
+    for (auto it = mapDepths.lower_bound(minDepth); it != mapDepths.end(); ++it)
+        nTotal += it->second;
     return nTotal;
 }
 
-CAmount CWallet::GetImmatureBalance() const
+CAmount CWallet::SaplingAddressBalances::Confirmed(int minDepth) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    // Same depth test as GetFilteredNotes, notarised depth only past one confirmation
+    return SumFromDepth(minDepth > 1 ? mapByDpowConfs : mapByDepth, minDepth);
 }
 
-CAmount CWallet::GetWatchOnlyBalance() const
+CAmount CWallet::SaplingAddressBalances::Total(int minDepth) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+    return SumFromDepth(mapByDepth, minDepth) + SumFromDepth(mapLockedByDepth, minDepth);
+}
+
+CAmount CWallet::SaplingAddressBalances::Unconfirmed() const
+{
+    return Total(0) - Total(1);
+}
+
+CAmount CWallet::SaplingAddressBalances::Locked() const
+{
+    return SumFromDepth(mapLockedByDepth, 1);
+}
+
+CWallet::SaplingBalances CWallet::GetSaplingBalances() const
+{
+    LOCK2(cs_main, cs_wallet);
+    BalancesKey key = GetBalancesKey();
+    if (cachedSaplingBalancesKey && *cachedSaplingBalancesKey == key) {
+        return cachedSaplingBalances;
+    }
+
+    SaplingBalances ret;
+    for (const auto& p : mapWallet) {
+        const CWalletTx& wtx = p.second;
+        if (wtx.mapSaplingNoteData.empty() || !CheckFinalTx(wtx))
+            continue;
+
+        int nDepth = wtx.GetDepthInMainChain();
+        if (nDepth < 0)
+            continue;
+        bool fImmature = wtx.GetBlocksToMaturity() > 0;
+        int nDpowConfs = nDepth > 0 ? komodo_dpowconfs(tx_height(wtx.GetHash()), nDepth) : 0;
+
+        for (const auto& pair : wtx.mapSaplingNoteData) {
+            const SaplingOutPoint& op = pair.first;
+            const SaplingNoteData& nd = pair.second;
+            if (nd.nullifier && IsSaplingSpent(*nd.nullifier))
+                continue;
+
+            libzcash::SaplingExtendedFullViewingKey extfvk;
+            SaplingAddressBalances& balances = ret[nd.address];
+            balances.spendable = GetSaplingFullViewingKey(nd.ivk, extfvk) && HaveSaplingSpendingKey(extfvk);
+            if (fImmature) {
+                balances.immature += nd.value;
+            } else if (IsLockedNote(op)) {
+                balances.mapLockedByDepth[nDepth] += nd.value;
+            } else {
+                balances.mapByDepth[nDepth] += nd.value;
+                if (nDepth > 0)
+                    balances.mapByDpowConfs[nDpowConfs] += nd.value;
+            }
         }
     }
 
-    return nTotal;
+    cachedSaplingBalances = ret;
+    cachedSaplingBalancesKey = key;
+    return ret;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().mine_trusted;
+}
+
+CAmount CWallet::GetUnconfirmedBalance() const
+{
+    return GetBalances().mine_untrusted_pending;
+}
+
+CAmount CWallet::GetImmatureBalance() const
+{
+    return GetBalances().mine_immature;
+}
+
+CAmount CWallet::GetWatchOnlyBalance() const
+{
+    return GetBalances().watchonly_trusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!CheckFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().watchonly_untrusted_pending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().watchonly_immature;
 }
 
 CAmount CWallet::GetAvailableBalance(const CCoinControl *coinControl) const
@@ -7629,18 +7780,21 @@ std::vector<JSOutPoint> CWallet::ListLockedSproutNotes()
 void CWallet::LockNote(const SaplingOutPoint& output)
 {
     AssertLockHeld(cs_wallet);
+    MarkBalancesDirty();
     setLockedSaplingNotes.insert(output);
 }
 
 void CWallet::UnlockNote(const SaplingOutPoint& output)
 {
     AssertLockHeld(cs_wallet);
+    MarkBalancesDirty();
     setLockedSaplingNotes.erase(output);
 }
 
 void CWallet::UnlockAllSaplingNotes()
 {
     AssertLockHeld(cs_wallet);
+    MarkBalancesDirty();
     setLockedSaplingNotes.clear();
 }
 
@@ -7904,41 +8058,14 @@ bool CMerkleTx::AcceptToMemoryPool(bool fLimitFree, bool fRejectAbsurdFee)
 //Get Address balances for the GUI
 void CWallet::getZAddressBalances(std::map<libzcash::PaymentAddress, CAmount> &balances, int minDepth, bool requireSpendingKey)
 {
-
-    LOCK2(cs_main, cs_wallet);
-
-    for (auto & item : mapWallet) {
-        CWalletTx wtx = item.second;
-
-        // Filter the transactions before checking for notes
-        if (!CheckFinalTx(wtx) || wtx.GetBlocksToMaturity() > 0)
-            continue;
-
-        //Confirmed Balance Only
-        if (wtx.GetDepthInMainChain() < minDepth)
+    for (const auto& entry : GetSaplingBalances()) {
+        if (requireSpendingKey && !entry.second.spendable)
             continue;
 
-        for (auto & pair : wtx.mapSaplingNoteData) {
-            SaplingOutPoint op = pair.first;
-            SaplingNoteData nd = pair.second;
-
-            if (nd.nullifier && IsSaplingSpent(*nd.nullifier)) {
-                continue;
-            }
-
-            // skip notes which cannot be spent
-            if (requireSpendingKey) {
-                libzcash::SaplingExtendedFullViewingKey extfvk;
-                if (!(GetSaplingFullViewingKey(nd.ivk, extfvk) &&
-                    HaveSaplingSpendingKey(extfvk))) {
-                    continue;
-                }
-            }
-
-            if (!balances.count(nd.address))
-                balances[nd.address] = 0;
-            balances[nd.address] += CAmount(nd.value);
-        }
+        const SaplingAddressBalances& addrBalances = entry.second;
+        if (addrBalances.mapByDepth.lower_bound(minDepth) != addrBalances.mapByDepth.end() ||
+            addrBalances.mapLockedByDepth.lower_bound(minDepth) != addrBalances.mapLockedByDepth.end())
+            balances[entry.first] += addrBalances.Total(minDepth);
     }
 }
 
@@ -8021,6 +8148,15 @@ void CWallet::GetFilteredNotes(
 {
     LOCK2(cs_main, cs_wallet);
 
+    // Notes are selected on the address and value cached in SaplingNoteData,
+    // only the notes that are returned need their plaintext.
+    struct Candidate {
+        const CWalletTx* pwtx;
+        const SaplingOutPoint* pop;
+        const SaplingNoteData* pnd;
+        int confirmations;
+    };
+
     // When maxNotes > 0 use bounded streaming selection; otherwise fall through
     // to the original unbounded path (behaviour unchanged for existing callers).
     const bool bounded = (maxNotes > 0);
@@ -8028,69 +8164,62 @@ void CWallet::GetFilteredNotes(
 
     // smallestHeap: max-heap — top() is the largest-of-the-smallest candidates.
     // Evict top when a note with a lower value is seen.
-    auto cmpMax = [](const SaplingNoteEntry& a, const SaplingNoteEntry& b) {
-        return a.note.value() < b.note.value();
+    auto cmpMax = [](const Candidate& a, const Candidate& b) {
+        return a.pnd->value < b.pnd->value;
     };
     // largestHeap: min-heap — top() is the smallest-of-the-largest candidates.
     // Evict top when a note with a higher value is seen.
-    auto cmpMin = [](const SaplingNoteEntry& a, const SaplingNoteEntry& b) {
-        return a.note.value() > b.note.value();
+    auto cmpMin = [](const Candidate& a, const Candidate& b) {
+        return a.pnd->value > b.pnd->value;
     };
 
-    std::priority_queue<SaplingNoteEntry,
-                        std::vector<SaplingNoteEntry>,
+    std::priority_queue<Candidate,
+                        std::vector<Candidate>,
                         decltype(cmpMax)> smallestHeap(cmpMax);
-    std::priority_queue<SaplingNoteEntry,
-                        std::vector<SaplingNoteEntry>,
+    std::priority_queue<Candidate,
+                        std::vector<Candidate>,
                         decltype(cmpMin)> largestHeap(cmpMin);
+    std::vector<Candidate> vSelected;
     // Single aggregate tracks the combined total of both disjoint heaps.
     CAmount aggregateValue = 0;
     bool earlyExit = false;
 
-    for (auto & p : mapWallet) {
+    for (const auto & p : mapWallet) {
         if (earlyExit) break;
 
-        CWalletTx wtx = p.second;
+        const CWalletTx& wtx = p.second;
+        if (wtx.mapSaplingNoteData.empty())
+            continue;
 
         // Filter the transactions before checking for notes
         if (!CheckFinalTx(wtx) || wtx.GetBlocksToMaturity() > 0)
             continue;
 
+        int nDepth = wtx.GetDepthInMainChain();
         if (minDepth > 1) {
             int nHeight    = tx_height(wtx.GetHash());
-            int nDepth     = wtx.GetDepthInMainChain();
             int dpowconfs  = komodo_dpowconfs(nHeight,nDepth);
             if ( dpowconfs < minDepth || dpowconfs > maxDepth) {
                 continue;
             }
         } else {
-            if ( wtx.GetDepthInMainChain() < minDepth ||
-                wtx.GetDepthInMainChain() > maxDepth) {
+            if (nDepth < minDepth || nDepth > maxDepth) {
                 continue;
             }
         }
 
-        for (auto & pair : wtx.mapSaplingNoteData) {
-            SaplingOutPoint op = pair.first;
-            SaplingNoteData nd = pair.second;
-
-            auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
-
-            // The transaction would not have entered the wallet unless
-            // its plaintext had been successfully decrypted previously.
-            assert(optDeserialized != boost::none);
-
-            auto notePt = optDeserialized.get();
-            auto maybe_pa = nd.ivk.address(notePt.d);
-            assert(static_cast<bool>(maybe_pa));
-            auto pa = maybe_pa.get();
+        for (const auto & pair : wtx.mapSaplingNoteData) {
+            const SaplingOutPoint& op = pair.first;
+            const SaplingNoteData& nd = pair.second;
 
             // skip notes which belong to a different payment address in the wallet
-            if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
+            if (!(filterAddresses.empty() || filterAddresses.count(nd.address))) {
                 continue;
             }
 
             if (ignoreSpent && nd.nullifier && IsSaplingSpent(*nd.nullifier)) {
+                // The plaintext of a spent note is not needed again
+                mapSaplingDecryptedNotes.erase(op);
                 continue;
             }
 
@@ -8107,12 +8236,11 @@ void CWallet::GetFilteredNotes(
                 continue;
             }
 
-            auto note = notePt.note(nd.ivk).get();
-            SaplingNoteEntry entry { op, pa, note, notePt.memo(), wtx.GetDepthInMainChain() };
+            Candidate entry { &wtx, &op, &nd, nDepth };
 
             if (!bounded) {
                 // Unbounded path: original behaviour, all qualifying notes collected.
-                saplingEntries.push_back(entry);
+                vSelected.push_back(entry);
                 continue;
             }
 
@@ -8128,14 +8256,14 @@ void CWallet::GetFilteredNotes(
             //        Net aggregateValue change: +v (incoming) replaces nothing; the
             //        evicted value stays in the system via largestHeap if it qualifies.
             //   3. Otherwise → route directly to largestHeap.
-            CAmount v = CAmount(note.value());
+            CAmount v = nd.value;
 
             if ((int)smallestHeap.size() < halfNotes) {
                 smallestHeap.push(entry);
                 aggregateValue += v;
-            } else if (v < CAmount(smallestHeap.top().note.value())) {
-                SaplingNoteEntry evicted = smallestHeap.top();
-                CAmount evictedVal = CAmount(evicted.note.value());
+            } else if (v < smallestHeap.top().pnd->value) {
+                Candidate evicted = smallestHeap.top();
+                CAmount evictedVal = evicted.pnd->value;
                 // Remove evicted from aggregate; it may re-enter via largestHeap below.
                 aggregateValue -= evictedVal;
                 smallestHeap.pop();
@@ -8146,8 +8274,8 @@ void CWallet::GetFilteredNotes(
                 if ((int)largestHeap.size() < halfNotes) {
                     largestHeap.push(evicted);
                     aggregateValue += evictedVal;
-                } else if (evictedVal > CAmount(largestHeap.top().note.value())) {
-                    aggregateValue -= CAmount(largestHeap.top().note.value());
+                } else if (evictedVal > largestHeap.top().pnd->value) {
+                    aggregateValue -= largestHeap.top().pnd->value;
                     largestHeap.pop();
                     largestHeap.push(evicted);
                     aggregateValue += evictedVal;
@@ -8157,8 +8285,8 @@ void CWallet::GetFilteredNotes(
                 if ((int)largestHeap.size() < halfNotes) {
                     largestHeap.push(entry);
                     aggregateValue += v;
-                } else if (v > CAmount(largestHeap.top().note.value())) {
-                    aggregateValue -= CAmount(largestHeap.top().note.value());
+                } else if (v > largestHeap.top().pnd->value) {
+                    aggregateValue -= largestHeap.top().pnd->value;
                     largestHeap.pop();
                     largestHeap.push(entry);
                     aggregateValue += v;
@@ -8178,20 +8306,47 @@ void CWallet::GetFilteredNotes(
     }
 
     if (bounded) {
-        // Drain both disjoint heaps into saplingEntries.
+        // Drain both disjoint heaps.
         // Contains the smallest/largest notes seen before the early-exit fired
         // (or from the full wallet scan if minAggregateValue=0 or never satisfied).
         while (!smallestHeap.empty()) {
-            saplingEntries.push_back(smallestHeap.top());
+            vSelected.push_back(smallestHeap.top());
             smallestHeap.pop();
         }
         while (!largestHeap.empty()) {
-            saplingEntries.push_back(largestHeap.top());
+            vSelected.push_back(largestHeap.top());
             largestHeap.pop();
         }
     }
+
+    saplingEntries.reserve(saplingEntries.size() + vSelected.size());
+    for (const Candidate& candidate : vSelected) {
+        const SaplingDecryptedNote& decrypted = GetSaplingDecryptedNote(*candidate.pwtx, *candidate.pop, *candidate.pnd);
+        saplingEntries.push_back(SaplingNoteEntry { *candidate.pop, candidate.pnd->address, decrypted.note, decrypted.memo, candidate.confirmations });
+    }
 }
 
+/**
+ * Return the plaintext of a wallet note, decrypting it on first use.
+ */
+const SaplingDecryptedNote& CWallet::GetSaplingDecryptedNote(const CWalletTx& wtx, const SaplingOutPoint& op, const SaplingNoteData& nd)
+{
+    AssertLockHeld(cs_wallet);
+
+    auto it = mapSaplingDecryptedNotes.find(op);
+    if (it != mapSaplingDecryptedNotes.end())
+        return it->second;
+
+    auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
+
+    // The transaction would not have entered the wallet unless
+    // its plaintext had been successfully decrypted previously.
+    assert(optDeserialized != boost::none);
+
+    auto notePt = optDeserialized.get();
+    SaplingDecryptedNote decrypted { notePt.note(nd.ivk).get(), notePt.memo() };
+    return mapSaplingDecryptedNotes.emplace(op, decrypted).first->second;
+}
 
 //
 // Shielded key and address generalizations
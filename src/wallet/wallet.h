@@ -45,6 +45,7 @@
 #include "base58.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -97,6 +98,8 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //! target minimum change amount
 static const CAmount MIN_CHANGE = CENT;
+//! Blocks read ahead and trial decrypted together while rescanning
+static const unsigned int WALLET_RESCAN_WINDOW = 32;
 
 static const bool DEFAULT_DISABLE_WALLET = false;
 static const bool DEFAULT_WALLET_RBF = false;
@@ -408,6 +411,13 @@ struct CSproutNotePlaintextEntry
     int confirmations;
 };
 
+/** Plaintext of a wallet note that GetFilteredNotes has decrypted before. */
+struct SaplingDecryptedNote
+{
+    libzcash::SaplingNote note;
+    std::array<unsigned char, ZC_MEMO_SIZE> memo;
+};
+
 /** Sapling note, its location in a transaction, and number of confirmations. */
 struct SaplingNoteEntry
 {
@@ -625,17 +635,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -917,9 +917,13 @@ public:
 
     std::map<std::string, std::set<uint256>> mapAddressTxids;
     std::map<uint256, ArchiveTxPoint> mapArcTxs;
+    //Archived transactions in chain order, keyed by block height and position in the block
+    std::map<std::pair<int,int>, uint256> mapArcTxsByPosition;
     void LoadArcTxs(const uint256& wtxid, const ArchiveTxPoint& arcTxPt);
     void AddToArcTxs(const uint256& wtxid, ArchiveTxPoint& arcTxPt);
     void AddToArcTxs(const CWalletTx& wtx, int txHeight, ArchiveTxPoint& arcTxPt);
+    bool EraseFromArcTxs(const uint256& wtxid);
+    bool GetArcTxPosition(const uint256& wtxid, std::pair<int,int>& position) const;
 
     std::map<uint256, JSOutPoint> mapArcJSOutPoints;
     void AddToArcJSOutPoints(const uint256& nullifier, const JSOutPoint& op);
@@ -932,7 +936,7 @@ public:
      */
 
     bool ValidateSaplingWalletTrackedPositions(const CBlockIndex* pindex);
-    void IncrementSaplingWallet(const CBlockIndex* pindex);
+    void IncrementSaplingWallet(const CBlockIndex* pindex, const CBlock* pblockIn = nullptr);
     void DecrementSaplingWallet(const CBlockIndex* pindex);
 
 
@@ -1329,6 +1333,9 @@ public:
 
     std::map<uint256, SaplingOutPoint> mapSaplingNullifiersToNotes;
 
+    /* Decrypted notes, filled by GetFilteredNotes and pruned when they are seen spent */
+    std::map<SaplingOutPoint, SaplingDecryptedNote> mapSaplingDecryptedNotes;
+
     std::map<uint256, CWalletTx> mapWallet;
     bool fRunSetBestChain = false;
 
@@ -1608,6 +1615,7 @@ public:
     void ForceRescanWallet();
     void RescanWallet();
     void AddToWalletIfInvolvingMe(const std::vector<CTransaction> &vtx, std::vector<CTransaction> &vAddedTxes, const CBlock* pblock, const int nHeight, bool fUpdate, std::set<libzcash::SaplingPaymentAddress>& addressesFound, bool fRescan = false);
+    void AddToWalletIfInvolvingMe(const std::vector<CTransaction> &vtx, const std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> &saplingNoteDataAndAddressesToAdd, std::vector<CTransaction> &vAddedTxes, const CBlock* pblock, const int nHeight, bool fUpdate, std::set<libzcash::SaplingPaymentAddress>& addressesFound, bool fRescan = false);
     void WitnessNoteCommitment(
          std::vector<uint256> commitments,
          std::vector<boost::optional<SproutWitness>>& witnesses,
@@ -1621,6 +1629,65 @@ public:
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
+    /** Wallet wide transparent balances */
+    struct Balances {
+        CAmount mine_trusted = 0;           //!< Trusted, either confirmed or our own unconfirmed change
+        CAmount mine_untrusted_pending = 0; //!< Untrusted, but in mempool (pending)
+        CAmount mine_immature = 0;          //!< Immature coinbases in the main chain
+        CAmount watchonly_trusted = 0;
+        CAmount watchonly_untrusted_pending = 0;
+        CAmount watchonly_immature = 0;
+    };
+    /**
+     * All balances, summed in one pass over mapWallet. The sums are kept
+     * until a wallet transaction changes, the tip moves or the mempool changes.
+     */
+    Balances GetBalances() const;
+    /** Unspent Sapling notes of one payment address */
+    struct SaplingAddressBalances {
+        std::map<int, CAmount> mapByDepth;       //!< Mature and not locked, by depth (0 is the mempool)
+        std::map<int, CAmount> mapByDpowConfs;   //!< The confirmed ones of mapByDepth, by notarised depth
+        std::map<int, CAmount> mapLockedByDepth; //!< Mature and locked, by depth
+        CAmount immature = 0;                    //!< Immature coinbase outputs
+        bool spendable = false;                  //!< The wallet holds the spending key
+
+        /** Value GetFilteredNotes would return at minDepth or more, locked notes left out */
+        CAmount Confirmed(int minDepth) const;
+        /** Value at minDepth or more counting locked notes, by plain depth */
+        CAmount Total(int minDepth) const;
+        /** Value in the mempool, locked or not */
+        CAmount Unconfirmed() const;
+        /** Value of confirmed locked notes */
+        CAmount Locked() const;
+    };
+    typedef std::map<libzcash::SaplingPaymentAddress, SaplingAddressBalances> SaplingBalances;
+    /**
+     * Unspent Sapling notes of every wallet address, summed in one
+     * pass over mapWallet from the values kept in SaplingNoteData. Kept
+     * on the same terms as GetBalances(), and also reset when a note is
+     * locked or unlocked or a key is added.
+     */
+    SaplingBalances GetSaplingBalances() const;
+    //! Invalidate the balances kept by GetBalances() and GetSaplingBalances()
+    void MarkBalancesDirty() const { nBalancesGeneration++; }
+private:
+    /* What the kept balances depend on */
+    struct BalancesKey {
+        uint64_t nGeneration;
+        uint256 hashTip;
+        unsigned int nMempoolUpdated;
+
+        bool operator==(const BalancesKey& other) const {
+            return nGeneration == other.nGeneration && hashTip == other.hashTip && nMempoolUpdated == other.nMempoolUpdated;
+        }
+    };
+    BalancesKey GetBalancesKey() const;
+    mutable std::atomic<uint64_t> nBalancesGeneration{0};
+    mutable boost::optional<BalancesKey> cachedBalancesKey;
+    mutable Balances cachedBalances;
+    mutable boost::optional<BalancesKey> cachedSaplingBalancesKey;
+    mutable SaplingBalances cachedSaplingBalances;
+public:
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1659,6 +1726,7 @@ public:
         uint8_t n) const;
     mapSproutNoteData_t FindMySproutNotes(const CTransaction& tx) const;
     std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> FindMySaplingNotes(const std::vector<CTransaction> &vtx, int height) const;
+    std::vector<std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap>> FindMySaplingNotes(const std::vector<const std::vector<CTransaction>*> &vvtx, const std::vector<int> &vHeight) const;
     bool IsSproutNullifierFromMe(const uint256& nullifier) const;
     bool IsSaplingNullifierFromMe(const uint256& nullifier) const;
 
@@ -1834,6 +1902,8 @@ public:
                           bool ignoreLocked=true,
                           int maxNotes=0,
                           CAmount minAggregateValue=0);
+
+    const SaplingDecryptedNote& GetSaplingDecryptedNote(const CWalletTx& wtx, const SaplingOutPoint& op, const SaplingNoteData& nd);
 };
 
 /** A key allocated from the key pool. */
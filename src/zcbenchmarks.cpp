@@ -477,6 +477,56 @@ double benchmark_listunspent()
     return timer_stop(tv_start);
 }
 
+/**
+ * Time CWallet::ScanForWalletTransactions over the last nBlocks blocks. The
+ * scan runs on a scratch wallet given the Sapling viewing keys of the wallet,
+ * so it trial decrypts with the same keys and builds the Sapling wallet tree
+ * the same way, while the wallet itself is left alone. The scratch wallet
+ * file is removed afterwards.
+ */
+double benchmark_rescan(int nBlocks)
+{
+    const std::string strScratchFile = "benchmark-rescan.dat";
+    double duration;
+    {
+        CWallet scratch(strScratchFile);
+        bool fFirstRun = true;
+        if (scratch.LoadWallet(fFirstRun) != DB_LOAD_OK) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Failed to create the scratch wallet");
+        }
+
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        {
+            LOCK(scratch.cs_wallet);
+            std::set<libzcash::SaplingPaymentAddress> addresses;
+            pwalletMain->GetSaplingPaymentAddresses(addresses);
+            for (const auto& addr : addresses) {
+                libzcash::SaplingIncomingViewingKey ivk;
+                libzcash::SaplingExtendedFullViewingKey extfvk;
+                if (pwalletMain->GetSaplingIncomingViewingKey(addr, ivk) &&
+                    pwalletMain->GetSaplingFullViewingKey(ivk, extfvk)) {
+                    scratch.AddSaplingExtendedFullViewingKey(extfvk);
+                    scratch.AddSaplingIncomingViewingKey(ivk, addr);
+                }
+            }
+        }
+        CBlockIndex* pindexStart = chainActive[std::max(0, chainActive.Height() - nBlocks + 1)];
+
+        struct timeval tv_start;
+        timer_start(tv_start);
+        int nFound = scratch.ScanForWalletTransactions(pindexStart, true, true, false, true);
+        duration = timer_stop(tv_start);
+        LogPrint("bench", "benchmark_rescan: %d blocks, %d wallet transactions\n", chainActive.Height() - pindexStart->nHeight + 1, nFound);
+    }
+
+    {
+        LOCK(bitdb->cs_db);
+        bitdb->mapFileUseCount.erase(strScratchFile);
+    }
+    bitdb->RemoveDb(strScratchFile);
+    return duration;
+}
+
 double benchmark_create_sapling_spend()
 {
     auto sk = libzcash::SaplingSpendingKey::random();